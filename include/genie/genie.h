@@ -44,6 +44,10 @@ namespace genie
 
 		bool dump_reggraph = false;
 
+		// Check every latency solution against a plain lp_solve run of the whole
+		// latency MILP, and fail if they disagree. Slow, for debugging.
+		bool check_latency = false;
+
         bool force_full_merge = false;
 
 		bool no_merge_tree = false;
@@ -55,9 +59,36 @@ namespace genie
         bool no_topo_opt = false;
         std::vector<std::string> no_topo_opt_systems;
 
+		// Per-domain topology optimization budgets. 0 means unlimited.
+		double topo_opt_time = 0;
+		unsigned topo_opt_iters = 0;
+
+		// Optionally, topology candidates are only implemented if their estimated
+		// area improvement exceeds this margin. The estimate leaves out the registers
+		// and converters added during implementation, so this is off by default.
+		bool topo_est_screen = false;
+		int topo_est_margin = 0;
+
+		// Topology search strategy: steepest, greedy, or anneal.
+		// Annealing starts at topo_anneal_temp (0 = pick automatically), which
+		// is multiplied by topo_anneal_cooling after every candidate.
+		std::string topo_opt_strategy = "steepest";
+		unsigned topo_opt_seed = 1;
+		double topo_anneal_temp = 0;
+		double topo_anneal_cooling = 0.95;
+
+		// Initial topology for optimization: xbar (crossbar), or cluster
+		std::string topo_init = "xbar";
+
+		// Besides combining pairs of merge nodes, also try combining groups of them,
+		// pulling inputs out of shared merge nodes, and moving split node outputs
+		bool topo_extra_moves = false;
+
         bool no_mdelay = false;
 
 		unsigned max_logic_depth = 5;
+
+		unsigned jobs = 1;
     };
 
     struct ArchParams
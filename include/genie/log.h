@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <functional>
 
 namespace genie
@@ -31,5 +32,13 @@ namespace log
 
     using Handler = std::function<void(const Message&)>;
     void set_handler(const Handler&);
+
+    // While a thread has a buffer set, its messages are held there instead of
+    // going to the handler, until the buffer is flushed. Setting returns the
+    // previous buffer, and nullptr goes back to unbuffered.
+    using Buffer = std::vector<Message>;
+    Buffer* set_thread_buffer(Buffer*);
+    Buffer* get_thread_buffer();
+    void flush(Buffer&);
 }
 }
\ No newline at end of file
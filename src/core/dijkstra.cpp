@@ -3,6 +3,60 @@
 
 using namespace genie::impl;
 
+namespace
+{
+	// Grows a tree of shortest paths from 'src', stopping early once 'dest' is reached
+	// unless 'dest' is INVALID_V. prev_edge holds each reached vertex's incoming tree edge.
+	// Uses a binary heap with lazy deletion: a vertex can be in the heap more than once,
+	// and outdated entries are skipped when popped.
+	void grow_tree(const graph::CSRGraph& g, graph::VertexID src, graph::VertexID dest,
+		const graph::EArray<int>* distances, graph::VArray<graph::EdgeID>& prev_edge)
+	{
+		using namespace graph;
+		using HeapEntry = std::pair<int, VertexID>;
+
+		unsigned n_verts = g.n_verts();
+		VArray<int> shortest(n_verts, std::numeric_limits<int>::max());
+		VArray<bool> done(n_verts, false);
+		prev_edge.assign(n_verts, INVALID_E);
+
+		std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap;
+
+		shortest[src] = 0;
+		heap.emplace(0, src);
+
+		while (!heap.empty())
+		{
+			VertexID cur = heap.top().second;
+			heap.pop();
+
+			if (done[cur])
+				continue;
+
+			done[cur] = true;
+
+			if (cur == dest)
+				break;
+
+			int cur_cost = shortest[cur];
+
+			for (auto edge : g.dir_edges(cur))
+			{
+				VertexID neigh = g.sink_vert(edge);
+				int new_cost = cur_cost + (distances ? (*distances)[edge] : 1);
+
+				// Found new best path to 'neigh' through 'cur'
+				if (!done[neigh] && new_cost < shortest[neigh])
+				{
+					shortest[neigh] = new_cost;
+					prev_edge[neigh] = edge;
+					heap.emplace(new_cost, neigh);
+				}
+			}
+		}
+	}
+}
+
 // Finds a shortest path in graph g from vertex 'src' to vertex 'dest.
 // The function returns true if a path was found.
 // The path's vertices are stored in v_out, if it is not null.
@@ -12,102 +66,82 @@ using namespace genie::impl;
 bool graph::dijkstra(const Graph& g, VertexID src, VertexID dest, 
 	const E2Attr<int>* distances, VList* v_out, EList* e_out)
 {
-	// Initialize outputs
-	bool result = false;
+	// Run on a CSR version of the graph, then convert the path back
+	CSRGraph csr(g);
+	EArray<int> csr_distances;
+	if (distances)
+		csr_distances = csr.to_earray(*distances);
+
+	bool result = dijkstra(csr, csr.to_v(src), csr.to_v(dest),
+		distances ? &csr_distances : nullptr, v_out, e_out);
 
 	if (v_out)
-		v_out->clear();
+	{
+		for (auto& v : *v_out)
+			v = csr.orig_v(v);
+	}
 
 	if (e_out)
-		e_out->clear();
-
-	// For each vertex, keep track of the shortest path found so far from the source,
-	// and the previous vertex on said path.
-	struct Entry
 	{
-		int shortest = std::numeric_limits<int>::max();
-		VertexID prev = INVALID_V;
-	};
-
-	V2Attr<Entry> entries;
-
-	// Shortest path from src to src initialized to 0
-	entries[src].shortest = 0;
-
-	// Visitation list
-	VList to_visit{src};
+		for (auto& e : *e_out)
+			e = csr.orig_e(e);
+	}
 
-	while (!to_visit.empty())
-	{
-		// Find the vertex with the lowest cost to visit, and remove it from the list
-		auto cur_iter = std::min_element(to_visit.begin(), to_visit.end(), 
-			[&](VertexID a, VertexID b)
-		{
-			return entries[a].shortest < entries[b].shortest;
-		});
+	return result;
+}
 
-		VertexID cur = *cur_iter;
-		to_visit.erase(cur_iter);
+// Same as above, for CSR graphs
+bool graph::dijkstra(const CSRGraph& g, VertexID src, VertexID dest,
+	const EArray<int>* distances, VList* v_out, EList* e_out)
+{
+	if (v_out)
+		v_out->clear();
 
-		// If reached destination, then done
-		if (cur == dest)
-		{
-			result = true;
-			break;
-		}
+	if (e_out)
+		e_out->clear();
 
-		int cur_cost = entries[cur].shortest;
+	if (src == INVALID_V || dest == INVALID_V)
+		return false;
 
-		// Iterate through directed outbound neighbours
-		auto edges = g.dir_edges(cur);
-		for (auto edge : edges)
-		{
-			// Neighbour vertex and its information
-			int neigh = g.sink_vert(edge);
-			auto& neigh_entry = entries[neigh];
+	VArray<EdgeID> prev_edge;
+	grow_tree(g, src, dest, distances, prev_edge);
 
-			// Incremental cost of going to 'neigh' from 'cur'
-			int edge_cost = distances? distances->at(edge) : 1;
+	return shortest_path_to(g, prev_edge, src, dest, v_out, e_out);
+}
 
-			// Total cost of going from 'src' to 'neigh' through 'cur'
-			int new_cost = cur_cost + edge_cost;
+// Finds shortest paths from 'src' to every vertex reachable from it, in one go.
+// For each vertex, prev_edge receives the last edge on its path (INVALID_E if unreachable,
+// or for 'src' itself). Individual paths can then be extracted with shortest_path_to.
+void graph::shortest_path_tree(const CSRGraph& g, VertexID src,
+	const EArray<int>* distances, VArray<EdgeID>* prev_edge)
+{
+	grow_tree(g, src, INVALID_V, distances, *prev_edge);
+}
 
-			// Branch out to it if it's unvisited
-			if (neigh_entry.prev == INVALID_V)
-				to_visit.push_back(neigh);
+// Extracts the path from 'src' to 'dest' out of a shortest path tree.
+// Returns false if 'dest' isn't reachable.
+bool graph::shortest_path_to(const CSRGraph& g, const VArray<EdgeID>& prev_edge,
+	VertexID src, VertexID dest, VList* v_out, EList* e_out)
+{
+	if (v_out)
+		v_out->clear();
 
-			// Found new best path to 'neigh' through 'cur'
-			if (new_cost < neigh_entry.shortest)
-			{
-				neigh_entry.shortest = new_cost;
-				neigh_entry.prev = cur;
-			}
-		}
-	}
+	if (e_out)
+		e_out->clear();
 
-	// No path found? Early return
-	if (!result)
+	if (dest != src && prev_edge[dest] == INVALID_E)
 		return false;
 
-	// Populate result
-	VertexID cur = dest;
-	while (cur != src)
+	for (VertexID cur = dest; cur != src; )
 	{
+		EdgeID e = prev_edge[cur];
 		if (v_out) v_out->push_back(cur);
-		VertexID prev = entries[cur].prev;
-
-		if (e_out)
-		{
-			EdgeID e = g.edge(prev, cur);
-			assert(e != INVALID_E);
-			e_out->push_back(e);
-		}
-
-		cur = prev;
+		if (e_out) e_out->push_back(e);
+		cur = g.src_vert(e);
 	}
 
 	if (v_out) std::reverse(v_out->begin(), v_out->end());
 	if (e_out) std::reverse(e_out->begin(), e_out->end());
 
 	return true;
-}
\ No newline at end of file
+}
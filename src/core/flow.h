@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <mutex>
 #include "graph.h"
 #include "network.h"
 #include "address.h"
@@ -52,6 +53,23 @@ namespace flow
 		Transmissions m_xmis;
 	};
 
+	// A set of transmissions, stored as a bitset so that it can be checked against
+	// a transmission's exclusivity a word at a time
+	class TransmissionSet
+	{
+	public:
+		void add(TransmissionID);
+		void add(const TransmissionSet&);
+		bool contains(TransmissionID) const;
+		bool empty() const;
+		void clear();
+
+		PROP_GET(words, const std::vector<uint64_t>&, m_words);
+
+	protected:
+		std::vector<uint64_t> m_words;
+	};
+
 	class FlowStateOuter
 	{
 	public:
@@ -68,13 +86,19 @@ namespace flow
 		TransmissionID get_transmission_for_link(LinkID link);
 		
 		void set_transmissions_exclusive(TransmissionID t1, TransmissionID t2);
-		bool are_transmissions_exclusive(TransmissionID t1, TransmissionID t2);
+		// Make the members of each set exclusive with the members of all the other sets
+		void set_transmissions_exclusive(const std::vector<TransmissionSet>& sets);
+		bool are_transmissions_exclusive(TransmissionID t1, TransmissionID t2) const;
+		// Is t exclusive with every member of the set? (Every transmission is exclusive
+		// with itself.)
+		bool are_transmissions_exclusive(TransmissionID t, const TransmissionSet& set) const;
 
 	protected:
 		struct TransmissionInfo
 		{
 			std::vector<LinkID> links;
-			std::unordered_set<TransmissionID> exclusive_with;
+			// Row of the (symmetric) exclusivity matrix
+			TransmissionSet exclusive_with;
 		};
 
 		RSDomains m_rs_domains;
@@ -82,6 +106,41 @@ namespace flow
 		std::unordered_map<LinkID, TransmissionID> m_link_to_xmis;
 	};
 
+	// Latency solver state that persists across all the topology candidates implemented
+	// for one domain, which may be solved concurrently. MILP solutions are remembered
+	// under the canonical form of the problem they solve, so a problem that comes up
+	// again is answered without going through lp_solve.
+	class LatencySolverContext
+	{
+	public:
+		struct Stats
+		{
+			unsigned n_solves = 0;
+			unsigned n_diff = 0;
+			unsigned n_lp = 0;
+			unsigned n_reused = 0;
+			unsigned n_rows_removed = 0;
+			double lp_secs = 0;
+		};
+
+		bool find_solution(const std::string& problem, std::vector<int>& values);
+		void add_solution(const std::string& problem, const std::vector<int>& values);
+
+		void add_stats(const Stats&);
+		Stats get_stats() const;
+
+	protected:
+		// Beyond this many solutions, the least recently used one is forgotten
+		static constexpr unsigned MAX_SOLUTIONS = 1024;
+
+		using SolutionList = std::list<std::pair<std::string, std::vector<int>>>;
+
+		mutable std::mutex m_mutex;
+		SolutionList m_solutions; // most recently used first
+		std::unordered_map<std::string, SolutionList::iterator> m_solution_index;
+		Stats m_stats;
+	};
+
 	using N2GRemapFunc = std::function<HierObject*(HierObject*)>;
 	graph::Graph net_to_graph
 	(
@@ -94,8 +153,24 @@ namespace flow
 		const N2GRemapFunc& remap = N2GRemapFunc()
 	);
 
-	void do_inner(NodeSystem* sys, unsigned dom_id, FlowStateOuter* fs_out);
-	void solve_latency_constraints(NodeSystem* sys, unsigned dom_id);
+	// Same as net_to_graph, but builds a frozen CSR graph without going through a Graph.
+	// Vertices and edges are numbered the same way, unless the system keeps a NetIndex
+	// for the network type. Then its numbering is used, and recycled vertices and removed
+	// links show up as isolated vertices with null objects and unconnected null edges.
+	graph::CSRGraph net_to_csr_graph
+	(
+		NodeSystem* sys, NetType ntype,
+		bool include_internal,
+		graph::VArray<HierObject*>* v_to_obj,
+		graph::Attr2V<HierObject*>* obj_to_v,
+		graph::EArray<Link*>* e_to_link,
+		const N2GRemapFunc& remap = N2GRemapFunc()
+	);
+
+	void do_inner(NodeSystem* sys, unsigned dom_id, FlowStateOuter* fs_out,
+		LatencySolverContext* lat_ctx = nullptr);
+	void solve_latency_constraints(NodeSystem* sys, unsigned dom_id,
+		LatencySolverContext* lat_ctx = nullptr);
 	void dump_graph(Node* node, NetType net, const std::string& filename, bool labels);
 }
 }
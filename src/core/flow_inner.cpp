@@ -136,36 +136,35 @@ namespace
 		auto& tlinks = mg->get_endpoint(NET_TOPO, Dir::IN)->links();
 		bool exclusive = true; // assume until proven otherwise
 
-		for (auto it_topo1 = tlinks.begin(); 
-			exclusive && it_topo1 != tlinks.end(); ++it_topo1)
+		// Get the transmissions carried by each topo link, as a list and as a set
+		unsigned n_inputs = tlinks.size();
+		std::vector<std::vector<flow::TransmissionID>> xmis_lists(n_inputs);
+		std::vector<flow::TransmissionSet> xmis_sets(n_inputs);
+
+		for (unsigned i = 0; i < n_inputs; i++)
 		{
-			auto topo1 = *it_topo1;
-			auto logicals1 = rel.get_parents(topo1->get_id(), NET_RS_LOGICAL);
-			
-			for (auto it_topo2 = it_topo1 + 1; 
-				exclusive && it_topo2 != tlinks.end(); ++it_topo2)
+			for (auto log : rel.get_parents(tlinks[i]->get_id(), NET_RS_LOGICAL))
+			{
+				auto xmis = fs_out->get_transmission_for_link(log);
+				xmis_lists[i].push_back(xmis);
+				xmis_sets[i].add(xmis);
+			}
+		}
+
+		// Now check transmissions against each other. Two things to check:
+		// 1) are they the same transmission? if so, exclusive.
+		// 2) are they marked explicitly exclusive by the user? 
+		// Both are covered by checking against the other input's whole set at once.
+		for (unsigned i = 0; exclusive && i < n_inputs; i++)
+		{
+			for (unsigned j = i + 1; exclusive && j < n_inputs; j++)
 			{
-				auto topo2 = *it_topo2;
-				auto logicals2 = rel.get_parents(topo2->get_id(), NET_RS_LOGICAL);
-
-				// Now check logicals against each other. Two things to check:
-				// 1) do they belong to the same transmission? if so, exclusive.
-				// 2) are they marked explicitly exclusive by the user? 
-				for (auto it_log1 = logicals1.begin(); 
-					exclusive && it_log1 != logicals1.end(); ++it_log1)
+				for (auto xmis1 : xmis_lists[i])
 				{
-					auto log1 = *it_log1;
-					auto xmis1 = fs_out->get_transmission_for_link(log1);
-					for (auto it_log2 = logicals2.begin(); 
-						exclusive && it_log2 != logicals2.end(); ++it_log2)
+					if (!fs_out->are_transmissions_exclusive(xmis1, xmis_sets[j]))
 					{
-						auto log2 = *it_log2;
-						auto xmis2 = fs_out->get_transmission_for_link(log2);
-						if (xmis1 != xmis2 && !fstate.outer->are_transmissions_exclusive(xmis1, xmis2))
-						{
-							exclusive = false;
-							break;
-						}
+						exclusive = false;
+						break;
 					}
 				}
 			}
@@ -179,6 +178,9 @@ namespace
 		auto sys = fstate.sys;
 		auto& link_rel = sys->get_link_relations();
 
+		// For the merge node exclusivity checks. Relations get added afterwards.
+		link_rel.freeze();
+
 		// Gather splits and merges for this domain
 		auto splits = sys->get_children_by_type<NodeSplit>();
 		auto merges = sys->get_children_by_type<NodeMerge>();
@@ -446,6 +448,7 @@ namespace
 
 		auto e2e_links = sys->get_links(NET_RS_LOGICAL);
 		auto& link_rel = sys->get_link_relations();
+		link_rel.freeze();
 
 		// Traverse every end-to-end elemental transmission
 		for (auto& e2e_link : e2e_links)
@@ -521,12 +524,10 @@ namespace
 	{
 		using namespace graph;
 		auto sys = fstate.sys;
-		auto phys_links = sys->get_links(NET_RS_PHYS);
 
-		Attr2V<HierObject*> port_to_v;
-		V2Attr<HierObject*> v_to_port;
-		Graph g = flow::net_to_graph(sys, NET_RS_PHYS, true, 
-			&v_to_port, &port_to_v, nullptr, nullptr);
+		VArray<HierObject*> v_to_port;
+		CSRGraph g = flow::net_to_csr_graph(sys, NET_RS_PHYS, true, 
+			&v_to_port, nullptr, nullptr);
 
 		// Populate initial visitation list with ports that are either:
 		// 1) terminal (no outgoing edges)
@@ -535,13 +536,17 @@ namespace
 		// configurable.
 		std::deque<VertexID> to_visit;
 
-		std::copy_if(g.iter_verts.begin(), g.iter_verts.end(), std::back_inserter(to_visit),
-			[&](VertexID v)
+		for (VertexID v = 0; v < g.n_verts(); v++)
 		{
-			bool is_terminal = g.dir_neigh(v).empty();
+			// Skip unused vertices from the system's net index
+			if (!v_to_port[v])
+				continue;
+
+			bool is_terminal = g.dir_edges(v).empty();
 			bool bp_known = ((PortRS*)(v_to_port[v]))->get_bp_status().configurable == false;
-			return is_terminal || bp_known;
-		});
+			if (is_terminal || bp_known)
+				to_visit.push_back(v);
+		}
 
 		while (!to_visit.empty())
 		{
@@ -563,10 +568,13 @@ namespace
 			}
 
 			// Get feeders of this port. Could be internal or external links.
-			auto feeders = g.dir_neigh_r(cur_v);
-
-			for (auto next_v : feeders)
+			for (auto feeder_e : g.edges(cur_v))
 			{
+				if (g.sink_vert(feeder_e) != cur_v)
+					continue;
+
+				VertexID next_v = g.src_vert(feeder_e);
+
 				auto next_port = (PortRS*)v_to_port[next_v];
 				auto& next_bp = next_port->get_bp_status();
 
@@ -682,6 +690,7 @@ namespace
 		auto fstate_out = fstate_in.outer;
 		auto& link_rel = sys->get_link_relations();
 		auto& addr_rep = fstate_in.domain_addr_rep;
+		link_rel.freeze();
 
 		// Gather all physical RS links where:
 		// - the sink needs an xmis_id field
@@ -831,14 +840,16 @@ namespace
 		// are different between the two DataPorts, we will take the union (only the physfields present in both) since
 		// the missing ones will be defaulted later.
 
-		// Graph to do multiway algorithm on
-		Graph G;
+		// Vertex count and edges of the graph to do multiway algorithm on. The graph
+		// only exists once the edges are all known, so it gets built straight into CSR form.
+		unsigned n_verts = 0;
+		std::vector<VPair> edges;
 
 		// List of terminal vertices (one for each clock domain)
 		VList T;
 
-		// Edge weights in G
-		E2Attr<int> weights;
+		// Edge weights in G, indexed like edges
+		EArray<int> weights;
 
 		// Maps UNCONNECTED clock sinks to vertex IDs in G
 		Attr2E<PortClock*> clocksink_to_vid;
@@ -893,7 +904,7 @@ namespace
 					}
 					else
 					{
-						v = G.newv();
+						v = n_verts++;
 						clocksrc_to_vid[csrc] = v;
 						vid_to_clocksrc[v] = csrc;
 
@@ -911,7 +922,7 @@ namespace
 					}
 					else
 					{
-						v = G.newv();
+						v = n_verts++;
 						clocksink_to_vid[csink] = v;
 						vid_to_clocksink[v] = csink;
 					}
@@ -929,8 +940,8 @@ namespace
 			weight++;
 
 			// Create and add edge with weight
-			EdgeID e = G.newe(v_a, v_b);
-			weights[e] = weight;
+			edges.emplace_back(v_a, v_b);
+			weights.push_back(weight);
 		}
 
 		/*
@@ -952,6 +963,7 @@ namespace
 		});*/
 
 		// Call multiway cut algorithm, get vertex->terminal mapping
+		CSRGraph G(n_verts, edges);
 		auto vid_to_terminal = graph::multi_way_cut(G, weights, T);
 
 		// Iterate over all unconnected clock sinks, and connect them to the clock source
@@ -1579,7 +1591,8 @@ namespace
 	}
 }
 
-void flow::do_inner(NodeSystem* sys, unsigned dom_id, FlowStateOuter* fs_out)
+void flow::do_inner(NodeSystem* sys, unsigned dom_id, FlowStateOuter* fs_out,
+	LatencySolverContext* lat_ctx)
 {
 	FlowStateInner fstate;
 	fstate.dom_id = dom_id;
@@ -1602,7 +1615,7 @@ void flow::do_inner(NodeSystem* sys, unsigned dom_id, FlowStateOuter* fs_out)
 	do_backpressure(fstate); // all backpressure updating is incremental past this point
 
 	annotate_timing(fstate);
-	flow::solve_latency_constraints(sys, dom_id);
+	flow::solve_latency_constraints(sys, dom_id, lat_ctx);
 	lat_systolic_transform(fstate);
 	realize_latencies(fstate);
 
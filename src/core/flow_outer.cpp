@@ -16,12 +16,15 @@
 #include "port_clockreset.h"
 #include "port_rs.h"
 #include "topo_optimize.h"
+#include "parallel.h"
+#include <chrono>
 
 using namespace genie::impl;
 using genie::Exception;
 using genie::AddressVal;
 using flow::FlowStateOuter;
 using flow::TransmissionID;
+using flow::TransmissionSet;
 
 
 namespace
@@ -29,10 +32,19 @@ namespace
 	NodeSystem * create_snapshot(NodeSystem* sys, FlowStateOuter& fstate,
 		unsigned dom_id)
 	{
+		// Objects are cloned in order of first appearance, so that the snapshot
+		// doesn't depend on where they happen to be in memory
 		std::unordered_set<HierObject*> dom_objs;
+		std::vector<HierObject*> dom_objs_ordered;
 		std::vector<Link*> dom_links;
 		std::unordered_set<HierObject*> dom_ports;
 
+		auto add_dom_obj = [&](HierObject* obj)
+		{
+			if (dom_objs.insert(obj).second)
+				dom_objs_ordered.push_back(obj);
+		};
+
 		auto* dom = fstate.get_rs_domain(dom_id);
 
 		// Gather all RS logical links for the given domain
@@ -54,11 +66,11 @@ namespace
 				auto node = obj->get_parent_by_type<Node>();
 				if (node != sys)
 				{
-					dom_objs.insert(node);
+					add_dom_obj(node);
 				}
 				else
 				{
-					dom_objs.insert(obj);
+					add_dom_obj(obj);
 				}
 			}
 		}
@@ -77,16 +89,23 @@ namespace
 			auto clock_ports = sys->get_children_by_type<PortClock>();
 			auto reset_ports = sys->get_children_by_type<PortReset>();
 
-			dom_objs.insert(clock_ports.begin(), clock_ports.end());
-			dom_objs.insert(reset_ports.begin(), reset_ports.end());
+			for (auto port : clock_ports)
+				add_dom_obj(port);
+			for (auto port : reset_ports)
+				add_dom_obj(port);
 		}
 
 		// Create a clone of the input system, passing a flag to skip the default
 		// behavior of copying _all_ the contents of the system with it.
 		auto result = new NodeSystem(*sys, false);
 
+		// The snapshot and all the topology candidates and implementations derived
+		// from it keep their TOPO and RS_PHYS adjacency up to date as they're edited
+		result->enable_net_index(NET_TOPO);
+		result->enable_net_index(NET_RS_PHYS);
+
 		// Make copies of the objects and put them in the snapshot
-		for (auto obj : dom_objs)
+		for (auto obj : dom_objs_ordered)
 		{
 			result->add_child(obj->clone());
 		}
@@ -102,27 +121,30 @@ namespace
 		{
 			using namespace graph;
 
-			// Make a graph of the TOPO network
-			V2Attr<HierObject*> v_to_obj;
+			// Make a graph of the TOPO network. It's only traversed, so a CSR graph will do.
+			VArray<HierObject*> v_to_obj;
 			Attr2V<HierObject*> obj_to_v;
-			E2Attr<Link*> e_to_link;
-			Graph g = flow::net_to_graph(sys, NET_TOPO, true,
-				&v_to_obj, &obj_to_v,
-				&e_to_link, nullptr);
+			EArray<Link*> e_to_link;
+			CSRGraph g = flow::net_to_csr_graph(sys, NET_TOPO, true,
+				&v_to_obj, &obj_to_v, &e_to_link);
 
 			// Identify the subgraph that belong to just the domain we want.
 			// We do this by doing a directed graph traversal starting at the vertices
 			// corresponding to the contents of the dom_ports set (which are all the ports
 			// touched by the logical RS links for this domain).
 
-			// Set of already-visited vertices
-			std::unordered_set<VertexID> visited;
+			// Already-visited vertices
+			std::vector<bool> visited(g.n_verts(), false);
 
 			// Set of vertices yet to explore. Initialize to the vertices correponding to the
 			// dom_ports set of RS ports.
 			std::stack<VertexID> to_visit;
 			for (auto p : dom_ports)
-				to_visit.push(obj_to_v[p]);
+			{
+				auto it = obj_to_v.find(p);
+				if (it != obj_to_v.end())
+					to_visit.push(it->second);
+			}
 
 			// These hold our outputs: the set of split/merge nodes and topo links for this domain
 			std::vector<HierObject*> dom_splitmerge;
@@ -133,10 +155,10 @@ namespace
 				VertexID cur_v = to_visit.top();
 				to_visit.pop();
 
-				if (visited.count(cur_v))
+				if (visited[cur_v])
 					continue;
 
-				visited.insert(cur_v);
+				visited[cur_v] = true;
 
 				// Get object corresponding to the vertex
 				HierObject* cur_obj = v_to_obj[cur_v];
@@ -344,13 +366,29 @@ namespace
 
 	void rs_assign_domains(NodeSystem* sys, FlowStateOuter& fstate)
 	{
-		using namespace graph;
+		// Domains are the connected components of the RS logical network. Number the ports
+		// at the ends of the logical links, and group them with union-find.
+		auto links = sys->get_links(NET_RS_LOGICAL);
 
-		// We care about link->eid mapping and port->vid mapping
-		Attr2E<Link*> link_to_eid;
-		Attr2V<HierObject*> port_to_vid;
-		Graph rs_g = flow::net_to_graph(sys, NET_RS_LOGICAL, false, 
-			nullptr, &port_to_vid, nullptr, &link_to_eid);
+		std::unordered_map<HierObject*, unsigned> port_to_idx;
+		auto get_port_idx = [&](HierObject* port)
+		{
+			return port_to_idx.emplace(port, (unsigned)port_to_idx.size()).first->second;
+		};
+
+		std::vector<unsigned> link_src_idx;
+		link_src_idx.reserve(links.size());
+
+		for (auto link : links)
+		{
+			link_src_idx.push_back(get_port_idx(link->get_src()));
+			get_port_idx(link->get_sink());
+		}
+
+		graph::DisjointSets port_sets((unsigned)port_to_idx.size());
+
+		for (unsigned i = 0; i < links.size(); i++)
+			port_sets.unite(link_src_idx[i], port_to_idx[links[i]->get_sink()]);
 
 		// Add internal links from usernodes
 		for (auto node : sys->get_children_by_type<NodeUser>())
@@ -358,43 +396,39 @@ namespace
 			// Look for existing internal links
 			auto int_links = node->get_links(NET_RS_PHYS);
 
-			// Try to map the link's ports to vertices from the above graph.
+			// Try to map the link's ports to ones seen above.
 			// If they exist, connect them
 			for (auto link : int_links)
 			{
-				auto src_v_it = port_to_vid.find(link->get_src());
-				auto sink_v_it = port_to_vid.find(link->get_sink());
-				if (src_v_it != port_to_vid.end() &&
-					sink_v_it != port_to_vid.end())
+				auto src_it = port_to_idx.find(link->get_src());
+				auto sink_it = port_to_idx.find(link->get_sink());
+				if (src_it != port_to_idx.end() &&
+					sink_it != port_to_idx.end())
 				{
-					rs_g.newe(src_v_it->second, sink_v_it->second);
+					port_sets.unite(src_it->second, sink_it->second);
 				}
 			}
 		}
 
-		// Identify connected components (domains).
-		// Capture vid->domainid mapping and eid->domainid mapping
-		V2Attr<unsigned> vid_to_domain;
-		E2Attr<unsigned> eid_to_domain;
-		connected_comp(rs_g, &vid_to_domain, &eid_to_domain);
-
 		// Create the domain structures and sort the links into the domains.
-		for (auto& it : link_to_eid)
-		{
-			auto link = static_cast<LinkRSLogical*>(it.first);
-			auto eid = it.second;
+		// Domains are numbered in order of their first link.
+		std::vector<unsigned> set_to_domain(port_sets.size(), flow::DomainRS::INVALID);
+		unsigned n_domains = 0;
 
-			assert(eid_to_domain.count(eid));
-			unsigned dom_id = eid_to_domain[eid];
+		for (unsigned i = 0; i < links.size(); i++)
+		{
+			auto link = static_cast<LinkRSLogical*>(links[i]);
+			unsigned& dom_id = set_to_domain[port_sets.find(link_src_idx[i])];
 
-			auto dom = fstate.get_rs_domain(dom_id);
-			if (!dom)
+			if (dom_id == flow::DomainRS::INVALID)
 			{
-				dom = &fstate.new_rs_domain(dom_id);
+				dom_id = n_domains++;
+				auto& dom = fstate.new_rs_domain(dom_id);
 				// Name domain after the first src port seen
-				dom->set_name(link->get_src()->get_hier_path(sys));
+				dom.set_name(link->get_src()->get_hier_path(sys));
 			}
 
+			auto dom = fstate.get_rs_domain(dom_id);
 			dom->add_link(link->get_id());
 			link->set_domain_id(dom_id);
 		}
@@ -403,21 +437,27 @@ namespace
 	void rs_create_transmissions(NodeSystem* sys, FlowStateOuter& fstate)
 	{
 		// Go through all flows (logical RS links).
-		// Bin them by source
+		// Bin them by source. Bins are in order of first appearance, so that
+		// transmissions are numbered the same way every run.
 		auto links = sys->get_links(NET_RS_LOGICAL);
 
-		std::unordered_map<HierObject*, std::vector<LinkRSLogical*>> bin_by_src;
+		std::vector<std::pair<HierObject*, std::vector<LinkRSLogical*>>> bin_by_src;
+		std::unordered_map<HierObject*, unsigned> src_to_bin;
 
 		for (auto link : links)
 		{
 			auto src = link->get_src();
-			bin_by_src[src].push_back(static_cast<LinkRSLogical*>(link));
+			auto it = src_to_bin.emplace(src, (unsigned)bin_by_src.size());
+			if (it.second)
+				bin_by_src.emplace_back(src, std::vector<LinkRSLogical*>());
+
+			bin_by_src[it.first->second].second.push_back(static_cast<LinkRSLogical*>(link));
 		}
 
 		// Within each source bin, bin again by source address. 
 		// Each of these bins is a transmission
 		unsigned flow_id = 0;
-		for (auto src_bin : bin_by_src)
+		for (auto& src_bin : bin_by_src)
 		{
 			std::unordered_map<AddressVal, std::vector<LinkRSLogical*>> bin_by_addr;
 			for (auto link : src_bin.second)
@@ -444,21 +484,21 @@ namespace
 			}
 		}
 
-		// Process exclusivity specs. The specs are in terms of exclusive logical links,
-		// and we'll convert them into exclusive transmissions
+		// Process exclusivity specs. The specs are in terms of groups of exclusive
+		// logical links, and we'll convert them into groups of exclusive transmissions
 		auto& exspec = sys->get_spec().excl_info;
-		auto exlinks = exspec.get_links_with_exclusivity();
 
-		for (auto link1 : exlinks)
+		for (auto& group : exspec.get_groups())
 		{
-			auto& other_links = exspec.get_set(link1);
-			auto xmis1 = fstate.get_transmission_for_link(link1);
+			std::vector<TransmissionSet> xmis_group(group.size());
 
-			for (auto link2 : other_links)
+			for (unsigned i = 0; i < group.size(); i++)
 			{
-				auto xmis2 = fstate.get_transmission_for_link(link2);
-				fstate.set_transmissions_exclusive(xmis1, xmis2);
+				for (auto link : group[i])
+					xmis_group[i].add(fstate.get_transmission_for_link(link));
 			}
+
+			fstate.set_transmissions_exclusive(xmis_group);
 		}
 	}
 
@@ -548,14 +588,44 @@ namespace
 		// For each original topo source, and sink record:
 		struct Entry
 		{
+			// The original source/sink
+			HierObject* orig;
 			// The frontier port: equal to either the original source/sink,
 			// or a split/merge node
 			HierObject* head;
-			// The remote destinations that this connects to
-			std::unordered_set<HierObject*> remotes;
+			// The remote destinations that this connects to, in order of first appearance
+			std::vector<HierObject*> remotes;
+			std::unordered_set<HierObject*> remotes_set;
 		};
 
-		std::unordered_map<HierObject*, Entry> srces, sinks;
+		// Entries are kept in order of first appearance too, so that nodes and links
+		// are created in the same order every run
+		struct Entries
+		{
+			std::vector<Entry> list;
+			std::unordered_map<HierObject*, unsigned> index;
+
+			Entry& get(HierObject* obj)
+			{
+				auto it = index.emplace(obj, (unsigned)list.size());
+				if (it.second)
+				{
+					list.emplace_back();
+					list.back().orig = obj;
+					list.back().head = obj;
+				}
+
+				return list[it.first->second];
+			}
+
+			static void add_remote(Entry& en, HierObject* remote)
+			{
+				if (en.remotes_set.insert(remote).second)
+					en.remotes.push_back(remote);
+			}
+		};
+
+		Entries srces, sinks;
 
 		// Initialize sources, sinks
 		for (auto logical_link : logical_links)
@@ -563,22 +633,14 @@ namespace
 			auto rs_src = logical_link->get_src();
 			auto rs_sink = logical_link->get_sink();
 
-			// Get or create entries for src/sink
-			Entry& en_src = srces[rs_src];
-			Entry& en_sink = sinks[rs_sink];
-
-			en_src.head = rs_src;
-			en_src.remotes.insert(rs_sink);
-
-			en_sink.head = rs_sink;
-			en_sink.remotes.insert(rs_src);
+			Entries::add_remote(srces.get(rs_src), rs_sink);
+			Entries::add_remote(sinks.get(rs_sink), rs_src);
 		}
 
 		// Create split/merge nodes
-		for (auto& src : srces)
+		for (auto& en : srces.list)
 		{
-			HierObject* orig_src = src.first;
-			Entry& en = src.second;
+			HierObject* orig_src = en.orig;
 
 			if (en.remotes.size() > 1)
 			{
@@ -596,10 +658,9 @@ namespace
 			}
 		}
 
-		for (auto& sink : sinks)
+		for (auto& en : sinks.list)
 		{
-			HierObject* orig_sink = sink.first;
-			Entry& en = sink.second;
+			HierObject* orig_sink = en.orig;
 
 			if (en.remotes.size() > 1)
 			{
@@ -618,15 +679,14 @@ namespace
 		}
 
 		// Connect heads
-		for (auto& src : srces)
+		for (auto& src_en : srces.list)
 		{
-			Entry& src_en = src.second;
 			HierObject* src_head = src_en.head;
 
 			for (auto sink : src_en.remotes)
 			{
 				// Get the entry for the sink, retrieve head
-				Entry& sink_en = sinks[sink];
+				Entry& sink_en = sinks.get(sink);
 				HierObject* sink_head = sink_en.head;
 
 				// Connect
@@ -640,51 +700,71 @@ namespace
 		using namespace graph;
 
 		auto rs_links = sys->get_links(NET_RS_LOGICAL);
+		auto& link_rel = sys->get_link_relations();
 
-		// Turn the RS logical network into a graph.
+		// Turn the topo network into a graph.
 		// Maintain: vertexid<->port, edgeid->link mappings
-		E2Attr<Link*> eid_to_link;
-		V2Attr<HierObject*> vid_to_port;
+		EArray<Link*> eid_to_link;
 		Attr2V<HierObject*> port_to_vid;
-		Graph topo_g = flow::net_to_graph(sys, NET_TOPO, true, 
-			&vid_to_port, &port_to_vid,
-			&eid_to_link, nullptr, nullptr);
+		CSRGraph topo_g = flow::net_to_csr_graph(sys, NET_TOPO, true,
+			nullptr, &port_to_vid, &eid_to_link);
 
-		//topo_g.dump("debug", [=](VertexID v) {return topo_vid_to_port.at(v)->get_hier_path();});
+		// Group the RS links by source, so that a single shortest-path tree
+		// from each source can route all of its links. Sources are visited in
+		// order of first appearance.
+		std::vector<std::pair<HierObject*, std::vector<Link*>>> links_by_src;
+		std::unordered_map<HierObject*, unsigned> src_to_group;
 
-		for (auto& rs_link : rs_links)
+		for (auto rs_link : rs_links)
 		{
-			// Get endpoints
 			auto src = rs_link->get_src();
-			auto sink = rs_link->get_sink();
+			auto it = src_to_group.emplace(src, (unsigned)links_by_src.size());
+			if (it.second)
+				links_by_src.emplace_back(src, std::vector<Link*>());
 
-			// Find a route
-			bool result = false;
-			EList route_edges;
+			links_by_src[it.first->second].second.push_back(rs_link);
+		}
+
+		VArray<EdgeID> tree;
+		EList route_edges;
+
+		for (auto& group : links_by_src)
+		{
+			auto src = group.first;
 
 			// If route doesn't exist, vertices might not exist either, so check that first
 			auto src_it = port_to_vid.find(src);
-			auto sink_it = port_to_vid.find(sink);
+			VertexID v_src = src_it == port_to_vid.end() ? INVALID_V : src_it->second;
 
-			if (src_it != port_to_vid.end() && sink_it != port_to_vid.end())
-			{
-				VertexID v_src = port_to_vid[src];
-				VertexID v_sink = port_to_vid[sink];
-				result = graph::dijkstra(topo_g, v_src, v_sink, nullptr, nullptr, &route_edges);
-			}
+			if (v_src != INVALID_V)
+				graph::shortest_path_tree(topo_g, v_src, nullptr, &tree);
 
-			if (!result)
+			for (auto rs_link : group.second)
 			{
-				throw Exception("No route found from " + src->get_hier_path() + " to " +
-					sink->get_hier_path());
-			}
-			
-			// Walk the edges and associate the RS link with each constituent TOPO link
-			auto& link_rel = sys->get_link_relations();
-			for (auto& route_edge : route_edges)
-			{
-				Link* route_link = eid_to_link[route_edge];
-				link_rel.add(rs_link->get_id(), route_link->get_id());
+				auto sink = rs_link->get_sink();
+
+				// Find a route
+				bool result = false;
+				auto sink_it = port_to_vid.find(sink);
+
+				if (v_src != INVALID_V && sink_it != port_to_vid.end())
+				{
+					result = graph::shortest_path_to(topo_g, tree, v_src, sink_it->second,
+						nullptr, &route_edges);
+				}
+
+				if (!result)
+				{
+					throw Exception("No route found from " + src->get_hier_path() + " to " +
+						sink->get_hier_path());
+				}
+
+				// Walk the edges and associate the RS link with each constituent TOPO link
+				for (auto& route_edge : route_edges)
+				{
+					Link* route_link = eid_to_link[route_edge];
+					link_rel.add(rs_link->get_id(), route_link->get_id());
+				}
 			}
 		}
 	}
@@ -701,6 +781,17 @@ namespace
 		return result;
 	}
 
+	void log_lat_stats(FlowStateOuter& fstate, unsigned dom_id,
+		const flow::LatencySolverContext& lat_ctx)
+	{
+		auto lat_stats = lat_ctx.get_stats();
+		genie::log::info("latency solver for domain %s: %u solves, %u as difference constraints, "
+			"%u with lp_solve (%.3fs), %u reused, %u redundant rows removed",
+			fstate.get_rs_domain(dom_id)->get_name().c_str(), lat_stats.n_solves,
+			lat_stats.n_diff, lat_stats.n_lp, lat_stats.lp_secs, lat_stats.n_reused,
+			lat_stats.n_rows_removed);
+	}
+
 	NodeSystem* do_auto_domain(NodeSystem * snapshot, FlowStateOuter& fstate, unsigned dom_id)
 	{
 		// A pair representing a "system configuration":
@@ -726,9 +817,12 @@ namespace
 		// Initialize topology optimization with the crossbar topology
 		auto tstate = topo_opt::init(best_config.topo, fstate);
 
+		// Shared by all the candidates' latency solves
+		flow::LatencySolverContext lat_ctx;
+
 		// Implement the initial crossbar topology and measure its area
 		best_config.impl = best_config.topo->clone();
-		flow::do_inner(best_config.impl, dom_id, &fstate);
+		flow::do_inner(best_config.impl, dom_id, &fstate, &lat_ctx);
 		AreaMetrics best_area = measure_impl_area(best_config.impl);
 
 		bool skip_opt = fstate.get_rs_domain(dom_id)->get_opt_disabled();
@@ -744,81 +838,295 @@ namespace
 		// Outer loop starts here
 		//
 
-		// A bit hacky:
-		// best_config does not change until all of its possible derived topologies have been explored.
-		// new_best_config is what gets updated as exploration happens.
-		// Eventually, best_config gets replaced with new_best_config if one has been found.
-		// best_area is always updated
-		SysConfig new_best_config;
+		// Candidates are derived from the current base configuration. The search strategy
+		// decides which of them becomes the next base: right away (MOVE), or once the
+		// base runs out of candidates (KEEP). Separately, best_config always holds the
+		// best configuration seen so far, which is what gets returned.
+		// One configuration can fill several of these roles at the same time.
+		SysConfig base_config = best_config;
+		AreaMetrics base_area = best_area;
+		SysConfig kept_config;
+		AreaMetrics kept_area;
+
+		auto dispose = [&](const SysConfig& cfg)
+		{
+			if (!cfg.topo || cfg.topo == base_config.topo || cfg.topo == kept_config.topo ||
+				cfg.topo == best_config.topo)
+				return;
+
+			delete cfg.impl;
+			delete cfg.topo;
+		};
 
-		for (bool outer_loop_done = skip_opt, found_new_best = false; !outer_loop_done; )
+		auto& opts = genie::impl::get_flow_options();
+		std::unique_ptr<topo_opt::SearchStrategy> strategy(
+			topo_opt::create_strategy(opts.topo_opt_strategy, opts.topo_opt_seed + dom_id));
+
+		// Candidates are generated in batches, which are implemented concurrently.
+		// They're then offered in the order they were generated, so the outcome is the
+		// same as going through them one at a time. A MOVE throws away the rest of
+		// the batch, so strategies that can move go one candidate at a time and leave
+		// the threads to the latency solver instead.
+		unsigned batch_size = strategy->can_move() ? 1 : parallel::get_n_jobs();
+		bool cands_exhausted = false;
+
+		// Optional limits on optimization time and number of candidates implemented.
+		// Once either runs out, we stop and go with the best found so far.
+		auto opt_start = std::chrono::steady_clock::now();
+		unsigned n_cands = 0;
+		unsigned n_bases = 1;
+		const char* budget_hit = nullptr;
+
+		// All the topologies looked at so far, by topology key.
+		// Different merge sequences can arrive at the same topology. Repeats are thrown
+		// away without being implemented again, which also keeps the search from going
+		// around in circles.
+		std::unordered_set<std::string> seen_topos;
+		unsigned n_cache_hits = 0;
+		seen_topos.insert(topo_opt::topology_key(base_config.topo));
+
+		// Optionally, candidates are pre-screened with a cheap area estimate, relative to
+		// the estimate for the current base. Only those predicted to improve by more than
+		// the margin get implemented.
+		bool use_estimate = opts.topo_est_screen;
+		int base_est_area = 0;
+		unsigned n_screened = 0;
+
+		auto set_new_base = [&](const SysConfig& cfg, const AreaMetrics& area)
 		{
-			// Try and get next topology candidate
-			SysConfig cand_config;
-			cand_config.topo = topo_opt::iter_next(tstate);
+			SysConfig old_base = base_config;
+			SysConfig old_kept = kept_config;
 
-			// There exists a candidate
-			if (cand_config.topo)
+			base_config = cfg;
+			base_area = area;
+			kept_config = SysConfig();
+
+			dispose(old_base);
+			dispose(old_kept);
+
+			topo_opt::iter_newbase(tstate, base_config.topo);
+			cands_exhausted = false;
+
+			if (use_estimate)
 			{
-				// If we found a candidate, there could be more
-				outer_loop_done = false;
+				auto est = topo_opt::estimate_area(base_config.topo);
+				base_est_area = (int)(est.comb + est.reg);
+			}
+		};
 
-				// Implement the full system based on this topology and measure its area
-				cand_config.impl = cand_config.topo->clone();
-				flow::do_inner(cand_config.impl, dom_id, &fstate);
-				auto cand_area = measure_impl_area(cand_config.impl);
+		if (use_estimate)
+		{
+			auto est = topo_opt::estimate_area(base_config.topo);
+			base_est_area = (int)(est.comb + est.reg);
+		}
 
-				// If the area is better than the current best topology, then crown a new king.
-				// This also means we can continue the outer loop
-				unsigned best_area_total = best_area.comb + best_area.reg;
-				unsigned cand_area_total = cand_area.comb + cand_area.reg;
+		// Optionally, jump ahead from the crossbar to a topology made by clustering sinks
+		// using just the contention information. The search then refines that.
+		if (opts.topo_init == "cluster")
+		{
+			SysConfig seed_config;
+			seed_config.topo = skip_opt ? nullptr : topo_opt::make_clustered(tstate);
 
-				if (cand_area_total < best_area_total)
+			if (seed_config.topo)
+			{
+				seed_config.impl = seed_config.topo->clone();
+				flow::do_inner(seed_config.impl, dom_id, &fstate, &lat_ctx);
+				AreaMetrics seed_area = measure_impl_area(seed_config.impl);
+
+				n_cands++;
+				seen_topos.insert(topo_opt::topology_key(seed_config.topo));
+
+				if (seed_area.comb + seed_area.reg < best_area.comb + best_area.reg)
 				{
-					// best_config is now the best, and
-					// cand_config is now the inferior one
-					std::swap(cand_config, new_best_config);
-					std::swap(cand_area, best_area);
-
-					// A new best is found. Once iteration from the current-best is complete, we'll
-					// replace the current-best with new-best and restart iteration from it
-					found_new_best = true;
+					SysConfig old_best = best_config;
+					best_config = seed_config;
+					best_area = seed_area;
+					dispose(old_best);
 				}
 
-				// Cleanup the system that's worse than new_best_config
-				delete cand_config.impl;
-				delete cand_config.topo;
+				set_new_base(seed_config, seed_area);
 			}
-			else if (found_new_best)
+		}
+		else if (opts.topo_init != "xbar")
+		{
+			throw Exception("unknown initial topology type: " + opts.topo_init);
+		}
+
+		for (bool outer_loop_done = skip_opt; !outer_loop_done; )
+		{
+			// Check budgets
+			if (opts.topo_opt_iters > 0 && n_cands >= opts.topo_opt_iters)
 			{
-				// We've run out of candidates that derive from the current base, but
-				// we found a new best candidate among them.
-				// Set a new base, and let iteration restart from that.
+				budget_hit = "iteration";
+				break;
+			}
 
-				// Replace best_config with new_best_config
-				delete best_config.impl;
-				delete best_config.topo;
+			if (opts.topo_opt_time > 0)
+			{
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - opt_start;
+				if (elapsed.count() >= opts.topo_opt_time)
+				{
+					budget_hit = "time";
+					break;
+				}
+			}
+
+			// Try and get next batch of topology candidates
+			std::vector<SysConfig> batch;
+			std::vector<std::string> batch_keys;
+			while (!cands_exhausted && batch.size() < batch_size &&
+				(opts.topo_opt_iters == 0 || n_cands + batch.size() < opts.topo_opt_iters))
+			{
+				SysConfig cand_config;
+				cand_config.topo = topo_opt::iter_next(tstate);
+
+				if (!cand_config.topo)
+				{
+					cands_exhausted = true;
+					continue;
+				}
+
+				// Skip ones already seen, including earlier in this batch
+				auto key = topo_opt::topology_key(cand_config.topo);
+				if (seen_topos.count(key) || util::exists(batch_keys, key))
+				{
+					n_cache_hits++;
+					delete cand_config.topo;
+					continue;
+				}
+
+				if (use_estimate)
+				{
+					auto est = topo_opt::estimate_area(cand_config.topo);
+					int est_delta = (int)(est.comb + est.reg) - base_est_area;
+					if (-est_delta <= opts.topo_est_margin)
+					{
+						n_screened++;
+						delete cand_config.topo;
+						continue;
+					}
+				}
+
+				batch.push_back(cand_config);
+				batch_keys.push_back(std::move(key));
+			}
+
+			// There exists a candidate
+			if (!batch.empty())
+			{
+				// Implement the full systems based on these topologies and measure their area
+				std::vector<AreaMetrics> batch_areas(batch.size());
+				parallel::for_each_index(batch.size(), batch_size, [&](unsigned i)
+				{
+					batch[i].impl = batch[i].topo->clone();
+					flow::do_inner(batch[i].impl, dom_id, &fstate, &lat_ctx);
+					batch_areas[i] = measure_impl_area(batch[i].impl);
+				});
 
-				best_config = new_best_config;
+				for (unsigned i = 0; i < batch.size(); i++)
+				{
+					auto& cand_config = batch[i];
+					auto& cand_area = batch_areas[i];
+					n_cands++;
+					seen_topos.insert(std::move(batch_keys[i]));
+
+					unsigned cand_area_total = cand_area.comb + cand_area.reg;
+					unsigned base_area_total = base_area.comb + base_area.reg;
+					unsigned kept_area_total = kept_config.topo ?
+						kept_area.comb + kept_area.reg : base_area_total;
+					unsigned best_area_total = best_area.comb + best_area.reg;
+
+					// Crown a new king?
+					if (cand_area_total < best_area_total)
+					{
+						SysConfig old_best = best_config;
+						best_config = cand_config;
+						best_area = cand_area;
+						dispose(old_best);
+					}
 
-				new_best_config.impl = nullptr;
-				new_best_config.topo = nullptr;
+					auto verdict = strategy->offer(cand_area_total, base_area_total, kept_area_total);
 
-				topo_opt::iter_newbase(tstate, best_config.topo);
+					if (verdict == topo_opt::SearchStrategy::Verdict::KEEP)
+					{
+						SysConfig old_kept = kept_config;
+						kept_config = cand_config;
+						kept_area = cand_area;
+						dispose(old_kept);
+					}
+					else if (verdict == topo_opt::SearchStrategy::Verdict::MOVE)
+					{
+						set_new_base(cand_config, cand_area);
+						n_bases++;
 
-				outer_loop_done = false;
-				found_new_best = false;
+						// The rest of the batch derives from the old base. Get rid of it
+						// as if it had never been generated.
+						for (unsigned j = i + 1; j < batch.size(); j++)
+						{
+							delete batch[j].impl;
+							delete batch[j].topo;
+						}
+						break;
+					}
+					else
+					{
+						dispose(cand_config);
+					}
+				}
+			}
+			else if (kept_config.topo)
+			{
+				// We've run out of candidates that derive from the current base, but
+				// the strategy kept one of them. Set a new base, and let iteration restart from that.
+				set_new_base(kept_config, kept_area);
+				n_bases++;
 			}
 			else
 			{
-				// A new best candidate wasn't found among the systems derived from the current base.
+				// Nowhere left to go from the current base.
 				// End the loop and use the best candidate as the answer.
 				outer_loop_done = true;
 			}
 		}
+
+		if (!skip_opt)
+		{
+			genie::log::info("topology cache for domain %s: %u hits, %u misses",
+				fstate.get_rs_domain(dom_id)->get_name().c_str(), n_cache_hits, n_cands);
+
+			if (use_estimate)
+			{
+				genie::log::info("area estimate screened out %u topology candidates for domain %s",
+					n_screened, fstate.get_rs_domain(dom_id)->get_name().c_str());
+			}
+		}
+
+		log_lat_stats(fstate, dom_id, lat_ctx);
+
+		if (budget_hit)
+		{
+			unsigned pairs_visited, pairs_total;
+			topo_opt::get_iter_progress(tstate, &pairs_visited, &pairs_total);
+
+			genie::log::info("topology optimization for domain %s stopped by %s budget after "
+				"%u candidates from %u base topologies (last base: covered %u of %u pair merges, "
+				"stopped during %s moves)",
+				fstate.get_rs_domain(dom_id)->get_name().c_str(), budget_hit,
+				n_cands, n_bases, pairs_visited, pairs_total, topo_opt::get_iter_move(tstate));
+		}
 	
 		topo_opt::cleanup(tstate);
 
+		// Clean up everything but the best configuration
+		{
+			SysConfig old_base = base_config;
+			SysConfig old_kept = kept_config;
+			base_config = SysConfig();
+			kept_config = SysConfig();
+			dispose(old_base);
+			dispose(old_kept);
+		}
+
 		// Return the best possible implementation of the original
 		// domain snapshot
 		delete best_config.topo;
@@ -832,34 +1140,99 @@ namespace
 		topo_do_routing(snapshot);
 
 		// Do the inner flow just once
-		flow::do_inner(snapshot, dom_id, &fstate);
+		flow::LatencySolverContext lat_ctx;
+		flow::do_inner(snapshot, dom_id, &fstate, &lat_ctx);
+		log_lat_stats(fstate, dom_id, lat_ctx);
 
 		return snapshot;
 	}
 
+	NodeSystem* do_domain(NodeSystem* snapshot, FlowStateOuter& fstate, unsigned dom_id)
+	{
+		if (fstate.get_rs_domain(dom_id)->get_is_manual())
+		{
+			return do_manual_domain(snapshot, fstate, dom_id);
+		}
+		else
+		{
+			return do_auto_domain(snapshot, fstate, dom_id);
+		}
+	}
+
 	void do_all_domains(NodeSystem* sys, FlowStateOuter& fstate)
 	{
-		for (auto& dom : fstate.get_rs_domains())
+		auto& doms = fstate.get_rs_domains();
+		unsigned n_doms = doms.size();
+
+		// Create snapshots of the original system, each just containing
+		// one domain and all the nodes connected to it.
+		//
+		// They're all taken up front from the same master system, so that
+		// each domain's result does not depend on the order or concurrency in which the
+		// domains are processed. Remember the master system's next link IDs at this point.
+		LinkIDMark snapshot_mark = sys->get_link_id_mark();
+		std::vector<NodeSystem*> snapshots(n_doms, nullptr);
+
+		for (unsigned i = 0; i < n_doms; i++)
 		{
-			auto dom_id = dom.get_id();
+			snapshots[i] = create_snapshot(sys, fstate, doms[i].get_id());
+		}
 
-			// Create snapshot of original system, just containing
-			// the current domain and all the nodes connected to it.
-			NodeSystem* in_snapshot = create_snapshot(sys, fstate, dom_id);
-			NodeSystem* out_snapshot = nullptr;
+		// Flesh out each domain, possibly on multiple threads. Each one only modifies its
+		// own snapshot, and only reads the master system and flow state.
+		// When they run concurrently, each domain's messages are held back and
+		// then logged in domain order, rather than interleaved.
+		bool buffer_logs = n_doms > 1 && parallel::get_n_jobs() > 1;
+		std::vector<genie::log::Buffer> dom_logs(n_doms);
 
-			if (dom.get_is_manual())
-			{
-				out_snapshot = do_manual_domain(in_snapshot, fstate, dom_id);
-			}
-			else
+		// Sets a thread's log buffer for as long as it's in scope
+		struct LogBufferScope
+		{
+			genie::log::Buffer* prev;
+			LogBufferScope(genie::log::Buffer* buf) : prev(genie::log::set_thread_buffer(buf)) {}
+			~LogBufferScope() { genie::log::set_thread_buffer(prev); }
+		};
+
+		auto flush_logs = [&]()
+		{
+			for (auto& dom_log : dom_logs)
+				genie::log::flush(dom_log);
+		};
+
+		try
+		{
+			parallel::for_each_index(n_doms, parallel::get_n_jobs(), [&](unsigned i)
 			{
-				out_snapshot = do_auto_domain(in_snapshot, fstate, dom_id);
-			}
+				LogBufferScope log_scope(buffer_logs ? &dom_logs[i] :
+					genie::log::get_thread_buffer());
+
+				// The snapshot belongs to do_domain while it's being worked on, which may
+				// free it and return a different system
+				auto snapshot = snapshots[i];
+				snapshots[i] = nullptr;
+				snapshots[i] = do_domain(snapshot, fstate, doms[i].get_id());
+			});
+		}
+		catch (...)
+		{
+			// Free the snapshots of domains that weren't started, and the results of
+			// the ones that finished
+			util::delete_all(snapshots);
+			flush_logs();
+			throw;
+		}
 
-			// Integrate the fleshed-out domain into the master system
-			sys->reintegrate(out_snapshot);
-			delete out_snapshot;
+		flush_logs();
+
+		// Integrate the fleshed-out domains into the master system, in domain order.
+		// Each snapshot's new links are first renumbered to follow on from the ones that
+		// the previous domains added.
+		for (unsigned i = 0; i < n_doms; i++)
+		{
+			auto snapshot = snapshots[i];
+			snapshot->rebase_new_links(snapshot_mark, sys->get_link_id_mark());
+			sys->reintegrate(snapshot);
+			delete snapshot;
 		}
 	}
 
@@ -867,6 +1240,7 @@ namespace
 	{
 		auto& queries = sys->get_spec().latency_queries;
 		auto& link_rel = sys->get_link_relations();
+		link_rel.freeze();
 
 		for (auto& query : queries)
 		{
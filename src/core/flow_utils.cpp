@@ -9,21 +9,9 @@ using namespace genie::impl::flow;
 using namespace genie::impl;
 using namespace genie::impl::graph;
 
-Graph flow::net_to_graph(NodeSystem* sys, NetType ntype,
-	bool include_internal,
-	V2Attr<HierObject*>* v_to_obj,
-	Attr2V<HierObject*>* obj_to_v,
-	E2Attr<Link*>* e_to_link,
-	Attr2E<Link*>* link_to_e,
-	const flow::N2GRemapFunc& remap)
+namespace
 {
-	Graph result;
-
-	// Gather all edges from system
-	auto links = sys->get_links(ntype);
-
-	// Gather all internal edges from nodes, if requested
-	if (include_internal)
+	void get_internal_links(NodeSystem* sys, NetType ntype, std::vector<Link*>& links)
 	{
 		for (auto node : sys->get_nodes())
 		{
@@ -36,6 +24,83 @@ Graph flow::net_to_graph(NodeSystem* sys, NetType ntype,
 		}
 	}
 
+	std::vector<Link*> get_net_links(NodeSystem* sys, NetType ntype, bool include_internal)
+	{
+		// Gather all edges from system
+		auto links = sys->get_links(ntype);
+
+		// Gather all internal edges from nodes, if requested
+		if (include_internal)
+			get_internal_links(sys, ntype, links);
+
+		return links;
+	}
+
+	CSRGraph index_to_csr_graph(NodeSystem* sys, NetIndex* index, NetType ntype,
+		bool include_internal,
+		VArray<HierObject*>* v_to_obj,
+		Attr2V<HierObject*>* obj_to_v,
+		EArray<Link*>* e_to_link)
+	{
+		// The system's own links come straight from the index, with its numbering.
+		// Internal links of child nodes aren't tracked by it, and get appended.
+		std::vector<Link*> int_links;
+		if (include_internal)
+			get_internal_links(sys, ntype, int_links);
+
+		if (v_to_obj) *v_to_obj = index->get_v_to_obj();
+		if (obj_to_v) *obj_to_v = index->get_obj_to_v();
+		if (e_to_link) *e_to_link = index->get_e_to_link();
+
+		if (int_links.empty())
+			return index->get_graph();
+
+		unsigned n_verts = index->n_verts();
+		std::vector<VPair> edges = index->get_edge_ends();
+		Attr2V<HierObject*> extra_verts;
+
+		for (auto link : int_links)
+		{
+			VertexID vs[2];
+			HierObject* objs[2] = { link->get_src(), link->get_sink() };
+
+			for (unsigned i = 0; i < 2; i++)
+			{
+				vs[i] = index->get_vertex(objs[i]);
+				if (vs[i] != INVALID_V)
+					continue;
+
+				auto it = extra_verts.emplace(objs[i], n_verts);
+				vs[i] = it.first->second;
+
+				if (it.second)
+				{
+					n_verts++;
+					if (v_to_obj) v_to_obj->push_back(objs[i]);
+					if (obj_to_v) obj_to_v->emplace(objs[i], vs[i]);
+				}
+			}
+
+			edges.emplace_back(vs[0], vs[1]);
+			if (e_to_link) e_to_link->push_back(link);
+		}
+
+		return CSRGraph(n_verts, edges);
+	}
+}
+
+Graph flow::net_to_graph(NodeSystem* sys, NetType ntype,
+	bool include_internal,
+	V2Attr<HierObject*>* v_to_obj,
+	Attr2V<HierObject*>* obj_to_v,
+	E2Attr<Link*>* e_to_link,
+	Attr2E<Link*>* link_to_e,
+	const flow::N2GRemapFunc& remap)
+{
+	Graph result;
+
+	auto links = get_net_links(sys, ntype, include_internal);
+
 	// Whether or not the caller needs one, we require an obj->v map.
 	// If the caller doesn't provide one, allocate (and then later free) a local one.
 	bool local_map = !obj_to_v;
@@ -91,6 +156,60 @@ Graph flow::net_to_graph(NodeSystem* sys, NetType ntype,
 	return result;
 }
 
+CSRGraph flow::net_to_csr_graph(NodeSystem* sys, NetType ntype,
+	bool include_internal,
+	VArray<HierObject*>* v_to_obj,
+	Attr2V<HierObject*>* obj_to_v,
+	EArray<Link*>* e_to_link,
+	const flow::N2GRemapFunc& remap)
+{
+	// Reuse the system's adjacency index if it keeps one
+	NetIndex* index = remap ? nullptr : sys->get_net_index(ntype);
+	if (index)
+	{
+		return index_to_csr_graph(sys, index, ntype, include_internal,
+			v_to_obj, obj_to_v, e_to_link);
+	}
+
+	auto links = get_net_links(sys, ntype, include_internal);
+
+	// Vertices and edges get numbered the same way as in net_to_graph
+	Attr2V<HierObject*> local_obj_to_v;
+	if (!obj_to_v)
+		obj_to_v = &local_obj_to_v;
+
+	obj_to_v->clear();
+	if (v_to_obj)
+		v_to_obj->clear();
+
+	std::vector<VPair> edges;
+	edges.reserve(links.size());
+
+	for (auto link : links)
+	{
+		VertexID vs[2];
+		HierObject* objs[2] = { link->get_src(), link->get_sink() };
+
+		for (unsigned i = 0; i < 2; i++)
+		{
+			HierObject* obj = remap ? remap(objs[i]) : objs[i];
+
+			auto it = obj_to_v->emplace(obj, (VertexID)obj_to_v->size());
+			vs[i] = it.first->second;
+
+			if (it.second && v_to_obj)
+				v_to_obj->push_back(obj);
+		}
+
+		edges.emplace_back(vs[0], vs[1]);
+	}
+
+	if (e_to_link)
+		*e_to_link = links;
+
+	return CSRGraph((unsigned)obj_to_v->size(), edges);
+}
+
 //
 // DomainRS
 //
@@ -171,6 +290,7 @@ TransmissionID FlowStateOuter::new_transmission()
 	TransmissionID result = m_transmissions.size();
 
 	m_transmissions.emplace_back(TransmissionInfo{ {} });
+	m_transmissions.back().exclusive_with.add(result);
 
 	return result;
 }
@@ -205,29 +325,110 @@ TransmissionID genie::impl::flow::FlowStateOuter::get_transmission_for_link(Link
 void genie::impl::flow::FlowStateOuter::set_transmissions_exclusive(TransmissionID t1,
 	TransmissionID t2)
 {
-	// ALways exclusive with yourself
-	if (t1 == t2) 
-		return;
+	// Store both ways, so that each row is complete by itself
+	m_transmissions[t1].exclusive_with.add(t2);
+	m_transmissions[t2].exclusive_with.add(t1);
+}
 
-	// Enforce canonical order, use half the space
-	if (t2 < t1) std::swap(t1, t2);
-	
-	m_transmissions[t1].exclusive_with.insert(t2);
+void genie::impl::flow::FlowStateOuter::set_transmissions_exclusive(
+	const std::vector<TransmissionSet>& sets)
+{
+	// Each member of set i is exclusive with the union of all sets except i.
+	// Get those unions from prefix and suffix unions, rather than going pair by pair.
+	unsigned n_sets = sets.size();
+	std::vector<TransmissionSet> before(n_sets + 1);
+	std::vector<TransmissionSet> after(n_sets + 1);
+
+	for (unsigned i = 0; i < n_sets; i++)
+	{
+		before[i + 1] = before[i];
+		before[i + 1].add(sets[i]);
+	}
+
+	for (unsigned i = n_sets; i > 0; i--)
+	{
+		after[i - 1] = after[i];
+		after[i - 1].add(sets[i - 1]);
+	}
+
+	for (unsigned i = 0; i < n_sets; i++)
+	{
+		auto& words = sets[i].get_words();
+
+		for (unsigned w = 0; w < words.size(); w++)
+		{
+			for (unsigned b = 0; b < 64; b++)
+			{
+				if (!((words[w] >> b) & 1))
+					continue;
+
+				auto& row = m_transmissions[w * 64 + b].exclusive_with;
+				row.add(before[i]);
+				row.add(after[i + 1]);
+			}
+		}
+	}
 }
 
 bool genie::impl::flow::FlowStateOuter::are_transmissions_exclusive(TransmissionID t1,
-	TransmissionID t2)
+	TransmissionID t2) const
 {
-	// Always exclusive with yourself
-	if (t1 == t2)
-		return true;
+	return m_transmissions[t1].exclusive_with.contains(t2);
+}
+
+bool genie::impl::flow::FlowStateOuter::are_transmissions_exclusive(TransmissionID t,
+	const TransmissionSet& set) const
+{
+	// Every member of the set must be in t's row
+	auto& row = m_transmissions[t].exclusive_with.get_words();
+	auto& words = set.get_words();
+
+	for (unsigned i = 0; i < words.size(); i++)
+	{
+		uint64_t row_word = i < row.size() ? row[i] : 0;
+		if (words[i] & ~row_word)
+			return false;
+	}
 
-	if (t2 < t1) std::swap(t1, t2);
+	return true;
+}
 
-	auto& excl = m_transmissions[t1].exclusive_with;
-	auto it = excl.find(t2);
+//
+// TransmissionSet
+//
+
+void TransmissionSet::add(TransmissionID xmis)
+{
+	unsigned word = xmis / 64;
+	if (word >= m_words.size())
+		m_words.resize(word + 1, 0);
 
-	return (it != excl.end());
+	m_words[word] |= (uint64_t)1 << (xmis % 64);
+}
+
+void TransmissionSet::add(const TransmissionSet& o)
+{
+	if (o.m_words.size() > m_words.size())
+		m_words.resize(o.m_words.size(), 0);
+
+	for (unsigned i = 0; i < o.m_words.size(); i++)
+		m_words[i] |= o.m_words[i];
+}
+
+bool TransmissionSet::contains(TransmissionID xmis) const
+{
+	unsigned word = xmis / 64;
+	return word < m_words.size() && ((m_words[word] >> (xmis % 64)) & 1);
+}
+
+bool TransmissionSet::empty() const
+{
+	return std::all_of(m_words.begin(), m_words.end(), [](uint64_t w) { return w == 0; });
+}
+
+void TransmissionSet::clear()
+{
+	m_words.clear();
 }
 
 void genie::impl::flow::dump_graph(Node* node, NetType net, const std::string& filename, bool labels)
@@ -160,6 +160,7 @@ void genie::impl::delete_node(const std::string & name)
 NetType genie::impl::register_network(NetworkDef* def)
 {
 	NetType ret = (NetType)m_networks.size();
+	assert(ret < LinkID::TYPE_INVALID); // must fit in a LinkID
 	m_networks.push_back(def);
 	def->set_id(ret);
 	return ret;
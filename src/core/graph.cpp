@@ -603,6 +603,39 @@ void Graph::union_with(const Graph& src)
 	m_next_eid = std::max(m_next_eid, src.m_next_eid);
 }
 
+void Graph::remap(const std::function<VertexID(VertexID)>& vfunc,
+	const std::function<EdgeID(EdgeID)>& efunc)
+{
+	VContType new_V;
+	EContType new_E;
+
+	// Edge lists keep their order, so neighbour traversal order is unchanged
+	for (auto& it : V)
+	{
+		auto& new_vstruct = new_V[vfunc(it.first)];
+		for (auto e : it.second.edges)
+			new_vstruct.edges.push_back(efunc(e));
+	}
+
+	for (auto& it : E)
+	{
+		auto& estruct = it.second;
+		VertexID v1 = estruct.v1 == INVALID_V ? INVALID_V : vfunc(estruct.v1);
+		VertexID v2 = estruct.v2 == INVALID_V ? INVALID_V : vfunc(estruct.v2);
+		new_E[efunc(it.first)] = Edge(v1, v2);
+	}
+
+	V = std::move(new_V);
+	E = std::move(new_E);
+	m_next_vid = vfunc(m_next_vid);
+	m_next_eid = efunc(m_next_eid);
+}
+
+EdgeID Graph::get_next_eid() const
+{
+	return m_next_eid;
+}
+
 void Graph::mergev(const VList& list)
 {
 	VertexID v0 = list.front();
@@ -610,4 +643,233 @@ void Graph::mergev(const VList& list)
 	{
 		mergev(list[i], v0);
 	}
-}
\ No newline at end of file
+}
+
+//
+// CSRGraph
+//
+
+CSRGraph::CSRGraph(const Graph& g)
+{
+	// Number vertices and edges in order of their original IDs
+	m_orig_v = g.verts();
+	m_orig_e = g.edges();
+	std::sort(m_orig_v.begin(), m_orig_v.end());
+	std::sort(m_orig_e.begin(), m_orig_e.end());
+
+	for (VertexID v = 0; v < m_orig_v.size(); v++)
+		m_from_orig_v[m_orig_v[v]] = v;
+
+	for (EdgeID e = 0; e < m_orig_e.size(); e++)
+		m_from_orig_e[m_orig_e[e]] = e;
+
+	std::vector<VPair> ends;
+	ends.reserve(m_orig_e.size());
+	for (auto orig : m_orig_e)
+	{
+		auto vs = g.verts(orig);
+		ends.emplace_back(to_v(vs.first), to_v(vs.second));
+	}
+
+	m_all_offs.assign(m_orig_v.size() + 1, 0);
+	m_out_offs.assign(m_orig_v.size() + 1, 0);
+	build(ends);
+}
+
+CSRGraph::CSRGraph(unsigned n_verts, const std::vector<VPair>& edges)
+{
+	m_all_offs.assign(n_verts + 1, 0);
+	m_out_offs.assign(n_verts + 1, 0);
+	build(edges);
+}
+
+void CSRGraph::build(const std::vector<VPair>& ends)
+{
+	m_ends = ends;
+
+	// Count edges per vertex, ignoring dangling ends. Self-loops are counted once.
+	for (auto& vs : m_ends)
+	{
+		if (vs.first != INVALID_V)
+		{
+			m_all_offs[vs.first + 1]++;
+			if (vs.second != INVALID_V)
+				m_out_offs[vs.first + 1]++;
+		}
+
+		if (vs.second != INVALID_V && vs.second != vs.first)
+			m_all_offs[vs.second + 1]++;
+	}
+
+	// Turn counts into offsets
+	for (unsigned v = 1; v < m_all_offs.size(); v++)
+	{
+		m_all_offs[v] += m_all_offs[v - 1];
+		m_out_offs[v] += m_out_offs[v - 1];
+	}
+
+	// Fill, in edge order
+	m_all_edges.resize(m_all_offs.back());
+	m_out_edges.resize(m_out_offs.back());
+	std::vector<unsigned> all_pos(m_all_offs.begin(), m_all_offs.end() - 1);
+	std::vector<unsigned> out_pos(m_out_offs.begin(), m_out_offs.end() - 1);
+
+	for (EdgeID e = 0; e < m_ends.size(); e++)
+	{
+		auto& vs = m_ends[e];
+		if (vs.first != INVALID_V)
+		{
+			m_all_edges[all_pos[vs.first]++] = e;
+			if (vs.second != INVALID_V)
+				m_out_edges[out_pos[vs.first]++] = e;
+		}
+
+		if (vs.second != INVALID_V && vs.second != vs.first)
+			m_all_edges[all_pos[vs.second]++] = e;
+	}
+}
+
+VertexID CSRGraph::otherv(EdgeID e, VertexID self) const
+{
+	auto& vs = m_ends[e];
+	return vs.first == self ? vs.second : vs.first;
+}
+
+CSRGraph::EdgeRange CSRGraph::edges(VertexID v) const
+{
+	const EdgeID* base = m_all_edges.data();
+	return EdgeRange(base + m_all_offs[v], base + m_all_offs[v + 1]);
+}
+
+CSRGraph::EdgeRange CSRGraph::dir_edges(VertexID v) const
+{
+	const EdgeID* base = m_out_edges.data();
+	return EdgeRange(base + m_out_offs[v], base + m_out_offs[v + 1]);
+}
+
+VertexID CSRGraph::orig_v(VertexID v) const
+{
+	return m_orig_v.empty() ? v : m_orig_v[v];
+}
+
+EdgeID CSRGraph::orig_e(EdgeID e) const
+{
+	return m_orig_e.empty() ? e : m_orig_e[e];
+}
+
+VertexID CSRGraph::to_v(VertexID orig) const
+{
+	if (orig == INVALID_V)
+		return INVALID_V;
+
+	if (m_orig_v.empty())
+		return orig < n_verts() ? orig : INVALID_V;
+
+	auto it = m_from_orig_v.find(orig);
+	return it == m_from_orig_v.end() ? INVALID_V : it->second;
+}
+
+EdgeID CSRGraph::to_e(EdgeID orig) const
+{
+	if (m_orig_e.empty())
+		return orig < n_edges() ? orig : INVALID_E;
+
+	auto it = m_from_orig_e.find(orig);
+	return it == m_from_orig_e.end() ? INVALID_E : it->second;
+}
+
+// Connected components of a CSR graph. The Graph version is in min_color.cpp.
+int genie::impl::graph::connected_comp(const CSRGraph& g, VArray<unsigned>* vcolor, EArray<unsigned>* ecolor)
+{
+	const unsigned UNCOLORED = std::numeric_limits<unsigned>::max();
+	int colors = 0;
+
+	VArray<unsigned> local_vcolor;
+	if (!vcolor)
+		vcolor = &local_vcolor;
+
+	vcolor->assign(g.n_verts(), UNCOLORED);
+	if (ecolor)
+		ecolor->assign(g.n_edges(), UNCOLORED);
+
+	VList to_visit;
+
+	for (VertexID v = 0; v < g.n_verts(); v++)
+	{
+		if ((*vcolor)[v] != UNCOLORED)
+			continue;
+
+		// Paint v and everything connected to it as 'colors'
+		(*vcolor)[v] = colors;
+		to_visit.push_back(v);
+
+		while (!to_visit.empty())
+		{
+			VertexID u = to_visit.back();
+			to_visit.pop_back();
+
+			for (auto e : g.edges(u))
+			{
+				if (ecolor) (*ecolor)[e] = colors;
+
+				VertexID neigh = g.otherv(e, u);
+				if ((*vcolor)[neigh] == UNCOLORED)
+				{
+					(*vcolor)[neigh] = colors;
+					to_visit.push_back(neigh);
+				}
+			}
+		}
+
+		colors++;
+	}
+
+	return colors;
+}
+
+//
+// DisjointSets
+//
+
+DisjointSets::DisjointSets(unsigned n)
+	: m_parent(n), m_rank(n, 0)
+{
+	for (unsigned i = 0; i < n; i++)
+		m_parent[i] = i;
+}
+
+unsigned DisjointSets::find(unsigned x)
+{
+	// Find the root, then point everything on the way directly at it
+	unsigned root = x;
+	while (m_parent[root] != root)
+		root = m_parent[root];
+
+	while (m_parent[x] != root)
+	{
+		unsigned next = m_parent[x];
+		m_parent[x] = root;
+		x = next;
+	}
+
+	return root;
+}
+
+bool DisjointSets::unite(unsigned x, unsigned y)
+{
+	x = find(x);
+	y = find(y);
+
+	if (x == y)
+		return false;
+
+	// Attach the shallower tree under the deeper one
+	if (m_rank[x] < m_rank[y])
+		std::swap(x, y);
+
+	m_parent[y] = x;
+	if (m_rank[x] == m_rank[y])
+		m_rank[x]++;
+
+	return true;
+}
@@ -160,6 +160,15 @@ namespace graph
 		// Add new vertices and edges from another graph
 		void union_with(const Graph&);
 
+		// Renumber all vertices and edges in place, keeping the structure intact.
+		// The mapping functions must be one-to-one, and are also applied to the
+		// next-free vertex/edge IDs.
+		void remap(const std::function<VertexID(VertexID)>& vfunc,
+			const std::function<EdgeID(EdgeID)>& efunc);
+
+		// The ID that the next newe() call will use
+		EdgeID get_next_eid() const;
+
 		// Dump the graph to a .dot file, with an optional edge annotation function
 		void dump(const std::string& filename,
 			const std::function<std::string(VertexID)>& vfunc = nullptr,
@@ -181,12 +190,168 @@ namespace graph
 		EdgeID m_next_eid = 0;
 	}; // end Graph class
 
+	// Dense attributes for CSRGraph, indexed directly by vertex/edge ID
+	template<class T> using VArray = std::vector<T>;
+	template<class T> using EArray = std::vector<T>;
+
+	// A frozen, compact (compressed sparse row) graph for running algorithms on.
+	// Vertices and edges are numbered 0..N-1, and each vertex's edges are stored
+	// contiguously, so walking them doesn't allocate. It can't be modified once built.
+	//
+	// When built from a Graph, vertices and edges are numbered in order of their
+	// original IDs, which can be converted back and forth with orig_v/orig_e and to_v/to_e.
+	class CSRGraph
+	{
+	public:
+		// A range of edge IDs, usable in range-based for loops
+		class EdgeRange
+		{
+		public:
+			EdgeRange(const EdgeID* b, const EdgeID* e) : m_begin(b), m_end(e) {}
+			const EdgeID* begin() const { return m_begin; }
+			const EdgeID* end() const { return m_end; }
+			unsigned size() const { return (unsigned)(m_end - m_begin); }
+			bool empty() const { return m_begin == m_end; }
+
+		private:
+			const EdgeID* m_begin;
+			const EdgeID* m_end;
+		};
+
+		CSRGraph() = default;
+		explicit CSRGraph(const Graph& g);
+		// Directed edges (v1, v2) between vertices 0..n_verts-1. Edge i is edges[i].
+		CSRGraph(unsigned n_verts, const std::vector<VPair>& edges);
+
+		unsigned n_verts() const { return (unsigned)m_all_offs.size() - 1; }
+		unsigned n_edges() const { return (unsigned)m_ends.size(); }
+
+		// Edge properties
+		VPair verts(EdgeID e) const { return m_ends[e]; }
+		VertexID src_vert(EdgeID e) const { return m_ends[e].first; }
+		VertexID sink_vert(EdgeID e) const { return m_ends[e].second; }
+		VertexID otherv(EdgeID e, VertexID self) const;
+
+		// All edges touching a vertex, and only the ones directed away from it
+		EdgeRange edges(VertexID v) const;
+		EdgeRange dir_edges(VertexID v) const;
+
+		// Conversion to/from the IDs of the Graph this was built from
+		VertexID orig_v(VertexID v) const;
+		EdgeID orig_e(EdgeID e) const;
+		VertexID to_v(VertexID orig) const;
+		EdgeID to_e(EdgeID orig) const;
+
+		// Conversion of attributes to/from the Graph this was built from
+		template<class T> VArray<T> to_varray(const V2Attr<T>& attr, const T& dflt = T()) const;
+		template<class T> EArray<T> to_earray(const E2Attr<T>& attr, const T& dflt = T()) const;
+		template<class T> V2Attr<T> from_varray(const VArray<T>& arr) const;
+		template<class T> E2Attr<T> from_earray(const EArray<T>& arr) const;
+
+	private:
+		void build(const std::vector<VPair>& ends);
+
+		// Endpoints of each edge
+		std::vector<VPair> m_ends;
+
+		// Edges of vertex v are m_all_edges[m_all_offs[v] .. m_all_offs[v+1]-1],
+		// likewise for outgoing edges
+		std::vector<unsigned> m_all_offs = { 0 };
+		EList m_all_edges;
+		std::vector<unsigned> m_out_offs = { 0 };
+		EList m_out_edges;
+
+		// Original IDs. Empty when built from an edge list.
+		VList m_orig_v;
+		EList m_orig_e;
+		V2Attr<VertexID> m_from_orig_v;
+		E2Attr<EdgeID> m_from_orig_e;
+	};
+
+	template<class T>
+	VArray<T> CSRGraph::to_varray(const V2Attr<T>& attr, const T& dflt) const
+	{
+		VArray<T> result(n_verts(), dflt);
+		for (auto& it : attr)
+		{
+			auto v = to_v(it.first);
+			if (v != INVALID_V)
+				result[v] = it.second;
+		}
+		return result;
+	}
+
+	template<class T>
+	EArray<T> CSRGraph::to_earray(const E2Attr<T>& attr, const T& dflt) const
+	{
+		EArray<T> result(n_edges(), dflt);
+		for (auto& it : attr)
+		{
+			auto e = to_e(it.first);
+			if (e != INVALID_E)
+				result[e] = it.second;
+		}
+		return result;
+	}
+
+	template<class T>
+	V2Attr<T> CSRGraph::from_varray(const VArray<T>& arr) const
+	{
+		V2Attr<T> result;
+		for (VertexID v = 0; v < n_verts(); v++)
+			result.emplace(orig_v(v), arr[v]);
+		return result;
+	}
+
+	template<class T>
+	E2Attr<T> CSRGraph::from_earray(const EArray<T>& arr) const
+	{
+		E2Attr<T> result;
+		for (EdgeID e = 0; e < n_edges(); e++)
+			result.emplace(orig_e(e), arr[e]);
+		return result;
+	}
+
+	// Disjoint sets of elements 0..N-1 (union-find), with path compression and union by rank.
+	// Finds connected components in near-linear time without building a graph.
+	class DisjointSets
+	{
+	public:
+		explicit DisjointSets(unsigned n);
+
+		// Representative element of the set containing x
+		unsigned find(unsigned x);
+		// Merge the sets containing x and y. Returns false if they were already the same set.
+		bool unite(unsigned x, unsigned y);
+
+		unsigned size() const { return (unsigned)m_parent.size(); }
+
+	private:
+		std::vector<unsigned> m_parent;
+		std::vector<unsigned char> m_rank;
+	};
+
 	// Algorithm declarations go here for now
 	V2Attr<VertexID> multi_way_cut(Graph g, const E2Attr<int>& weights, VList T);
 	int min_st_cut(Graph& g, E2Attr<int> weights, VertexID s, VertexID t);
 	int connected_comp(Graph& g, V2Attr<unsigned>* vcolor, E2Attr<unsigned>* ecolor);
 	bool dijkstra(const Graph& g, VertexID src, VertexID dest, 
 		const E2Attr<int>* distances, VList* v_out, EList* e_out);
+
+	// Same as above, on CSR graphs with dense attributes
+	VArray<VertexID> multi_way_cut(const CSRGraph& g, const EArray<int>& weights, const VList& T);
+	int min_st_cut(const CSRGraph& g, const EArray<int>& weights, VertexID s, VertexID t,
+		EArray<bool>* cut_edges);
+	int min_st_cut(const CSRGraph& g, const EArray<int>& weights,
+		const VArray<VertexID>& vmap, unsigned n_view, VertexID s, VertexID t,
+		VArray<bool>* s_side);
+	int connected_comp(const CSRGraph& g, VArray<unsigned>* vcolor, EArray<unsigned>* ecolor);
+	bool dijkstra(const CSRGraph& g, VertexID src, VertexID dest,
+		const EArray<int>* distances, VList* v_out, EList* e_out);
+	void shortest_path_tree(const CSRGraph& g, VertexID src,
+		const EArray<int>* distances, VArray<EdgeID>* prev_edge);
+	bool shortest_path_to(const CSRGraph& g, const VArray<EdgeID>& prev_edge,
+		VertexID src, VertexID dest, VList* v_out, EList* e_out);
 }
 }
 }
\ No newline at end of file
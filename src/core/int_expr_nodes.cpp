@@ -1,4 +1,5 @@
 #include "pch.h"
+#include <cstring>
 #include "genie/genie.h"
 #include "int_expr_nodes.h"
 #include "int_expr.h"
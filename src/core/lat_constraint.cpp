@@ -6,11 +6,17 @@
 #include "net_topo.h"
 #include "port_rs.h"
 #include "flow.h"
+#include "parallel.h"
 #include "lp_lib.h"
+#include "myblas.h"
+#include <chrono>
+#include <iomanip>
+#include <set>
 
 using namespace genie::impl;
 using namespace flow;
 using namespace graph;
+using genie::Exception;
 using Dir = genie::Port::Dir;
 
 namespace
@@ -37,6 +43,10 @@ namespace
 		// System we're operating on
 		NodeSystem* sys;
 
+		// Optional state that outlives this solve, and stats to report to it
+		LatencySolverContext* ctx = nullptr;
+		LatencySolverContext::Stats stats;
+
 		// LPSolve constraints and objective
 		std::vector<LPConstraint> lp_constraints;
 		LPObjective lp_objective;
@@ -392,11 +402,11 @@ namespace
 		unsigned max_logic_depth = sys->get_spec().max_logic_depth;
 		auto& reg_graph = sstate.reg_graph;
 
-		E2Attr<Link*> g1_e2link;
-		V2Attr<HierObject*> g1_v2port;
-		Graph g1 = flow::net_to_graph(sys, NET_RS_PHYS, true,
-			&g1_v2port, nullptr,
-			&g1_e2link, nullptr);;
+		// Only the links are needed. Snapshots keep a NET_RS_PHYS index, so this
+		// doesn't rebuild anything for them.
+		EArray<Link*> phys_links;
+		flow::net_to_csr_graph(sys, NET_RS_PHYS, true,
+			nullptr, nullptr, &phys_links);
 
 		std::vector<LinkRSPhys*> int_links;
 
@@ -407,11 +417,14 @@ namespace
 		//    - the src/sink of this external link belong to modules...
 		//      create vertices representing the registered cores of those modules,
 		//      and create edges annotated with the ports' internal combinational depths
-		for (auto eid : g1.iter_edges)
+		for (Link* ext_link : phys_links)
 		{
+			// Skip links removed since the index was built
+			if (!ext_link)
+				continue;
+
 			// Make sure the link is external.
 			// If internal, save for later
-			Link* ext_link = g1_e2link[eid];
 			LinkID ext_link_id = ext_link->get_id();
 			bool is_external = ext_link == sys->get_link(ext_link_id);
 
@@ -523,187 +536,363 @@ namespace
 		}
 	}
 
+	// Combinational depth is limited by looking at windows: paths through the reg graph
+	// whose weight (logic depth) is within the limit. Extending a window by one more edge
+	// either gives another window, or an overweight path. If that path's just barely
+	// overweight (dropping its first edge would make it fit again), one of its interior
+	// vertices must be registered, and that becomes a constraint.
+	//
+	// Windows are grown depth-first from every vertex with one shared path. Every edge
+	// weighs at least 1 once zero-weight edges are merged away, so windows are at most
+	// max_logic_depth edges long and their number is polynomial in the size of the graph,
+	// even where paths fork and reconverge a lot. For the same reason, loops need no
+	// special treatment.
+	struct WindowState
+	{
+		SolverState& sstate;
+		unsigned max_weight;
+		std::unordered_map<VertexID, EList> out_edges;
+		std::vector<VertexID> path;
+		std::set<std::vector<VertexID>> covers;
+	};
+
+	void grow_window(WindowState& wstate, unsigned weight, unsigned first_weight)
+	{
+		auto& sstate = wstate.sstate;
+		VertexID head = wstate.path.back();
+
+		auto it = wstate.out_edges.find(head);
+		if (it == wstate.out_edges.end())
+			return;
+
+		for (auto e : it->second)
+		{
+			unsigned edge_weight = sstate.reg_graph_weights[e];
+			unsigned new_weight = weight + edge_weight;
+
+			if (new_weight <= wstate.max_weight)
+			{
+				wstate.path.push_back(sstate.reg_graph.sink_vert(e));
+				grow_window(wstate, new_weight,
+					wstate.path.size() == 2 ? edge_weight : first_weight);
+				wstate.path.pop_back();
+			}
+			else if (wstate.path.size() == 1)
+			{
+				// A single edge that's too heavy can't be helped by registers, and has no
+				// interior. Ask for a register on its source, as this always has.
+				wstate.covers.insert(wstate.path);
+			}
+			else if (new_weight - first_weight <= wstate.max_weight)
+			{
+				// Interior vertices are all of the window but its first vertex.
+				// Sorted, so that the same set coming from different windows is only
+				// counted once.
+				std::vector<VertexID> cover(wstate.path.begin() + 1, wstate.path.end());
+				std::sort(cover.begin(), cover.end());
+				cover.erase(std::unique(cover.begin(), cover.end()), cover.end());
+				wstate.covers.insert(cover);
+			}
+		}
+	}
+
 	void create_reg_constraints(SolverState& sstate)
 	{
-		unsigned max_weight = sstate.sys->get_spec().max_logic_depth;
 		auto& reg_graph = sstate.reg_graph;
 
-		struct SnakeState
+		WindowState wstate{ sstate, sstate.sys->get_spec().max_logic_depth };
+		for (auto e : reg_graph.iter_edges)
+			wstate.out_edges[reg_graph.src_vert(e)].push_back(e);
+
+		for (auto v : reg_graph.iter_verts)
 		{
-			std::deque<VertexID> verts;
-			unsigned total_weight;
-			unsigned unvisited;
-		};
+			wstate.path.assign(1, v);
+			grow_window(wstate, 0, 0);
+		}
 
-		std::unordered_set<VertexID> visited;
-		std::queue<SnakeState> snakes;
+		// Each distinct set of vertices becomes one constraint:
+		// 1*y0 + 1*y1 + 1*y2 + ... >= 1
+		// where yi are binary variables that say whether or not at least one
+		// register is needed on the corresponding external physical link.
+		for (auto& cover : wstate.covers)
+		{
+			LPConstraint lp_constraint;
 
-		// Generate initial snakes from terminal src vertices in reg graph
-		for (auto v : reg_graph.iter_verts)
+			for (auto v : cover)
+			{
+				auto varno = get_or_create_reg_var(sstate, (LinkID)v);
+				lp_constraint.coefs.push_back(1);
+				lp_constraint.varnos.push_back(varno);
+			}
+
+			lp_constraint.op = ROWTYPE_GE;
+			lp_constraint.rhs = 1;
+			sstate.lp_constraints.push_back(lp_constraint);
+		}
+	}
+
+	struct LPConstraintHash
+	{
+		size_t operator()(const LPConstraint* row) const
 		{
-			// No backwards edges? We want it.
-			if (reg_graph.dir_neigh_r(v).empty())
+			size_t result = std::hash<int>()(row->op) ^ (std::hash<int>()(row->rhs) << 1);
+			for (unsigned i = 0; i < row->varnos.size(); i++)
 			{
-				snakes.emplace();
-				auto& newsnake = snakes.back();
-				newsnake.verts.push_back(v);
-				newsnake.unvisited = 0;
-				newsnake.total_weight = 0;
+				size_t term = std::hash<int>()(row->varnos[i]) ^
+					(std::hash<double>()(row->coefs[i]) << 1);
+				result ^= term + 0x9e3779b9 + (result << 6) + (result >> 2);
 			}
+			return result;
 		}
+	};
 
-		// Process snakes
-		while (!snakes.empty())
+	struct LPConstraintEq
+	{
+		bool operator()(const LPConstraint* l, const LPConstraint* r) const
 		{
-			auto& cur_snake = snakes.front();
-			bool snake_done = false;
+			return l->op == r->op && l->rhs == r->rhs &&
+				l->varnos == r->varnos && l->coefs == r->coefs;
+		}
+	};
 
-			while (!snake_done)
-			{
-				VertexID cur_head = cur_snake.verts.back();
+	// Cleans up the constraints before they're solved. Terms are sorted by varno
+	// (combining repeats and dropping zeros), and exact duplicate rows are removed.
+	// Then, covering rows (all coefficients 1, >= a positive constant) are removed if
+	// another covering row over a subset of their variables, with at least the same
+	// constant, already implies them. All variables are nonnegative, so that's safe.
+	void remove_redundant_constraints(SolverState& sstate)
+	{
+		auto& rows = sstate.lp_constraints;
+		std::vector<bool> redundant(rows.size(), false);
+
+		for (auto& row : rows)
+		{
+			std::vector<std::pair<int, double>> terms;
+			for (unsigned i = 0; i < row.varnos.size(); i++)
+				terms.emplace_back(row.varnos[i], row.coefs[i]);
+
+			std::sort(terms.begin(), terms.end());
 
-				// Assume the snake head has just been newly advanced into.
-				// Check if it's been visited or not, and add to unvisited count if so
-				if (!visited.count(cur_head))
-					cur_snake.unvisited++;
+			row.varnos.clear();
+			row.coefs.clear();
 
-				// See if the total snake weight violates the constraint
-				if (cur_snake.total_weight > max_weight)
+			for (auto& term : terms)
+			{
+				if (!row.varnos.empty() && row.varnos.back() == term.first)
+					row.coefs.back() += term.second;
+				else
 				{
-					// Advance snake tail until snake weight is under the constraint
-					// again.
-					// Make sure to keep a snake that has at least 2 vertices in it
-					// so that head != tail.
+					row.varnos.push_back(term.first);
+					row.coefs.push_back(term.second);
+				}
 
-					while (cur_snake.total_weight > max_weight &&
-						cur_snake.verts.size() > 2)
-					{
-						// Advance tail.
-						VertexID old_tail = cur_snake.verts.front();
-						cur_snake.verts.pop_front();
-						VertexID new_tail = cur_snake.verts.front();
-
-						// Mark outgoing tail as visited, update unvisited count
-						auto inserted = visited.insert(old_tail);
-						if (inserted.second)
-						{
-							// If inserted.second is true, then the visited set didn't have
-							// this vertex before, meaning it was previously unvisited before
-							// being marked visited. There is now one less unvisited vertex in
-							// the body of the snake.
-							cur_snake.unvisited--;
-							// If it was already visited before, inserting into the set
-							// is a safe null op
-						}
-
-						// Get the edge between the old tail and new tail.
-						// Its weight will be subtracted from the weight of the snake.
-						EdgeID e = reg_graph.edge(old_tail, new_tail);
-						assert(e != INVALID_E);
-						cur_snake.total_weight -= sstate.reg_graph_weights[e];
-
-					};
-
-					// If advancing the tail left us with no unvisited vertices left
-					// in the snake, we can finish.
-					if (cur_snake.unvisited == 0)
-					{
-						snake_done = true;
-						break;
-					}
+				if (row.coefs.back() == 0)
+				{
+					row.varnos.pop_back();
+					row.coefs.pop_back();
+				}
+			}
+		}
 
-					// Cur snake status: non-zero length by construction and
-					// total weight less than max total weight. Has unvisited vertices.
-					// Emit a constraint for the reg variables that each snake
-					// vertex represents.
-					// Use only vertices in the range [tail, head) of the snake.
-					// Canonically, it should be (tail, head) on a just-overweight snake 
-					// but we moved the tail vertex forwards an extra step as an optimization to
-					// avoid having to do it once more after constraint emission.
+		// Exact duplicates
+		std::unordered_set<const LPConstraint*, LPConstraintHash, LPConstraintEq> unique_rows;
+		for (unsigned i = 0; i < rows.size(); i++)
+		{
+			if (!unique_rows.insert(&rows[i]).second)
+				redundant[i] = true;
+		}
 
-					// Constraint:
-					// 1*y0 + 1*y1 + 1*y2 + ... >= 1
-					// where yi are binary variables that say whether or not at least one
-					// register is needed on the corresponding external physical link.
+		// Gather covering rows, smallest first so that a row is only ever implied by
+		// ones that have already been looked at. Among rows over the same variables,
+		// the one with the largest constant goes first.
+		std::vector<unsigned> covers;
+		for (unsigned i = 0; i < rows.size(); i++)
+		{
+			auto& row = rows[i];
+			if (redundant[i] || row.op != ROWTYPE_GE || row.rhs <= 0 || row.varnos.empty())
+				continue;
 
-					LPConstraint lp_constraint;
+			if (std::all_of(row.coefs.begin(), row.coefs.end(), [](double c) { return c == 1; }))
+				covers.push_back(i);
+		}
 
-					for (auto it = cur_snake.verts.begin(); it < cur_snake.verts.end() - 1; ++it)
-					{
-						LinkID link_id = (LinkID)*it;
-						auto varno = get_or_create_reg_var(sstate, link_id);
+		std::stable_sort(covers.begin(), covers.end(), [&](unsigned l, unsigned r)
+		{
+			return std::make_pair(rows[l].varnos.size(), -rows[l].rhs) <
+				std::make_pair(rows[r].varnos.size(), -rows[r].rhs);
+		});
 
-						lp_constraint.coefs.push_back(1);
-						lp_constraint.varnos.push_back(varno);
-					}
+		// Kept covering rows, indexed by their lowest varno. Any row that implies
+		// a given row must have its lowest varno among that row's varnos.
+		std::unordered_map<int, std::vector<unsigned>> kept_by_first;
+		std::vector<uint64_t> bits((sstate.next_varno + 63) / 64);
 
-					lp_constraint.op = ROWTYPE_GE;
-					lp_constraint.rhs = 1;
-					sstate.lp_constraints.push_back(lp_constraint);
-				} // if cur snake weight >= max snake weight
-
-				// Get the set of next vertices that the snake head can expand into.
-				// 3 possibilities:
-				// 1) set is empty: means we're at a terminal sink vertex. mark all remaining
-				//    snake vertices as visited and finish.
-				// 2) set has one member: extend the snake head to become this
-				// 3) set has >1 member: extend the snake head to become the first possiblity,
-				//    and create new snakes for the others (push onto stack for later)
-
-				auto next_vs = reg_graph.dir_neigh(cur_head);
-				if (next_vs.empty())
-				{
-					// Nowhere for head to go: snake done, everyone'v visited, go home
-					for (auto v : cur_snake.verts)
-						visited.insert(v);
-					snake_done = true;
-				}
-				else
+		for (auto i : covers)
+		{
+			auto& row = rows[i];
+
+			std::fill(bits.begin(), bits.end(), 0);
+			for (auto varno : row.varnos)
+				bits[varno / 64] |= (uint64_t)1 << (varno % 64);
+
+			for (auto varno : row.varnos)
+			{
+				auto it = kept_by_first.find(varno);
+				if (it == kept_by_first.end())
+					continue;
+
+				for (auto j : it->second)
 				{
-					// Go backwards through possibilities, such that the first candidate
-					// is done last. This ensures that _this_ snake is modified last,
-					// and pristine copies can be made beforehand.
-					for (auto it = next_vs.rbegin(); it != next_vs.rend(); ++it)
+					auto& other = rows[j];
+					if (other.rhs < row.rhs)
+						continue;
+
+					bool subset = std::all_of(other.varnos.begin(), other.varnos.end(),
+						[&](int v) { return (bits[v / 64] >> (v % 64)) & 1; });
+
+					if (subset)
 					{
-						// Other vertices: make a copy of current snake and extend it.
-						// First vertex: extend current snake (this must be done last)
-						auto snake = &cur_snake;
-						if (it != next_vs.rend()-1 )
-						{
-							snakes.emplace(cur_snake); // copy unmodified snake
-							snake = &snakes.back();
-						}
-
-						// The new head vertex
-						auto new_head = *it;
-
-						// Add weight of edge between cur_head and new_head to snake
-						EdgeID e = reg_graph.edge(cur_head, new_head);
-						snake->total_weight += sstate.reg_graph_weights[e];
-
-						// Extend the snake forward making new_head the new head
-						snake->verts.push_back(new_head);
+						redundant[i] = true;
+						break;
 					}
-				} // snake head does/doesn't have forward neighbours
-			} // while !snake_done
+				}
+
+				if (redundant[i])
+					break;
+			}
 
-			snakes.pop();
-		} // while !snakes.empty()
+			if (!redundant[i])
+				kept_by_first[row.varnos.front()].push_back(i);
+		}
+
+		// Compact what's left
+		unsigned n_kept = 0;
+		for (unsigned i = 0; i < rows.size(); i++)
+		{
+			if (redundant[i])
+				continue;
+
+			if (n_kept != i)
+				rows[n_kept] = std::move(rows[i]);
+			n_kept++;
+		}
+
+		sstate.stats.n_rows_removed += rows.size() - n_kept;
+		rows.resize(n_kept);
 	}
 
-	void solve_lp_constraints(SolverState& sstate)
+	// The MILP in a form that doesn't depend on the system it came from. Columns are
+	// named after the physical links they belong to and sorted by name, rows refer to
+	// columns and are sorted too. The same problem coming from different topology
+	// candidates has the same key.
+	struct CanonicalLP
+	{
+		// LPSolve variable number of each column, in column order
+		std::vector<int> col_varnos;
+		std::vector<bool> col_is_reg;
+
+		// Same as SolverState's, but with 1-based column numbers in place of varnos
+		std::vector<LPConstraint> rows;
+		LPObjective objective;
+
+		std::string key;
+	};
+
+	// Builds the canonical form of the sub-problem made of the given variables and rows.
+	// Variables are named by var_names ('L' or 'R' prefix, then the link) and obj_coefs
+	// gives their objective coefficients, both indexed by varno.
+	CanonicalLP canonicalize_lp(const SolverState& sstate, const std::vector<int>& varnos,
+		const std::vector<unsigned>& row_idxs, const std::vector<std::string>& var_names,
+		const std::vector<double>& obj_coefs)
 	{
-		auto& lp_constraints = sstate.lp_constraints;
+		CanonicalLP result;
+
+		std::vector<std::pair<std::string, int>> named_varnos;
+		for (auto varno : varnos)
+			named_varnos.emplace_back(var_names[varno], varno);
+
+		std::sort(named_varnos.begin(), named_varnos.end());
+
+		std::unordered_map<int, int> varno_to_col;
+		std::ostringstream key;
+
+		// Enough digits for any double to survive the round trip
+		key << std::setprecision(17);
+
+		for (auto& entry : named_varnos)
+		{
+			result.col_varnos.push_back(entry.second);
+			result.col_is_reg.push_back(entry.first[0] == 'R');
+			varno_to_col[entry.second] = (int)result.col_varnos.size();
+			key << entry.first << '\n';
+		}
 
+		// Rewrite rows in terms of columns, with terms sorted by column
+		for (auto row_idx : row_idxs)
+		{
+			auto& row = sstate.lp_constraints[row_idx];
+
+			std::vector<std::pair<int, double>> terms;
+			for (unsigned i = 0; i < row.varnos.size(); i++)
+				terms.emplace_back(varno_to_col[row.varnos[i]], row.coefs[i]);
+
+			std::sort(terms.begin(), terms.end());
+
+			result.rows.emplace_back();
+			auto& crow = result.rows.back();
+			crow.op = row.op;
+			crow.rhs = row.rhs;
+
+			for (auto& term : terms)
+			{
+				crow.varnos.push_back(term.first);
+				crow.coefs.push_back(term.second);
+			}
+		}
+
+		std::sort(result.rows.begin(), result.rows.end(),
+			[](const LPConstraint& l, const LPConstraint& r)
+		{
+			return std::tie(l.varnos, l.coefs, l.op, l.rhs) <
+				std::tie(r.varnos, r.coefs, r.op, r.rhs);
+		});
+
+		for (auto& row : result.rows)
+		{
+			for (unsigned i = 0; i < row.varnos.size(); i++)
+				key << row.coefs[i] << '*' << row.varnos[i] << ' ';
+
+			key << row.op << ' ' << row.rhs << '\n';
+		}
+
+		// Objective, in column order
+		auto direction = sstate.lp_objective.direction;
+		result.objective.direction = direction;
+		key << (direction == LPObjective::MIN ? "MIN" : "MAX");
+
+		for (unsigned col = 0; col < result.col_varnos.size(); col++)
+		{
+			double coef = obj_coefs[result.col_varnos[col]];
+			if (coef == 0)
+				continue;
+
+			result.objective.varno.push_back((int)col + 1);
+			result.objective.coef.push_back(coef);
+			key << ' ' << coef << '*' << col + 1;
+		}
+
+		result.key = key.str();
+		return result;
+	}
+
+	// Solves the canonical MILP and returns the values of all the columns
+	std::vector<int> run_lp_solve(const CanonicalLP& clp)
+	{
 		// Create lpsolve problem
 		// #rows = # of constraints
-		// #cols = # of variables (next_
-		int n_rows = (int)lp_constraints.size();
-		int n_cols = (int)sstate.varno_lat.size() + (int)sstate.varno_reg.size();
-
-		// Sometimes, there's just nothing to do
-		if (n_rows == 0 || n_cols == 0)
-			return;
+		// #cols = # of variables
+		int n_rows = (int)clp.rows.size();
+		int n_cols = (int)clp.col_varnos.size();
 
 		lprec* lp_prob = make_lp(n_rows, n_cols);
 		assert(lp_prob);
@@ -716,9 +905,9 @@ namespace
 		
 		// Transcribe the objective function
 		{
-			auto& obj = sstate.lp_objective;
-			auto result = set_obj_fnex(lp_prob, obj.coef.size(), obj.coef.data(),
-				obj.varno.data());
+			auto& obj = clp.objective;
+			auto result = set_obj_fnex(lp_prob, obj.coef.size(),
+				const_cast<double*>(obj.coef.data()), const_cast<int*>(obj.varno.data()));
 			assert(result);
 
 			switch (obj.direction)
@@ -737,24 +926,22 @@ namespace
 		// Rowmode must be on only when entering constraints. Also, the objective
 		// function must be specified before rowmode (and therefore also constraints).
 		set_add_rowmode(lp_prob, TRUE);
-		for (auto& row : lp_constraints)
+		for (auto& row : clp.rows)
 		{
-			auto result = add_constraintex(lp_prob, row.coefs.size(), row.coefs.data(),
-				row.varnos.data(), row.op, (double)row.rhs);
+			auto result = add_constraintex(lp_prob, row.coefs.size(),
+				const_cast<double*>(row.coefs.data()), const_cast<int*>(row.varnos.data()),
+				row.op, (double)row.rhs);
 			assert(result);
 		}
 		set_add_rowmode(lp_prob, FALSE);
 
-		// Make the latency variables integers
-		for (auto varno : sstate.varno_lat)
-		{
-			set_int(lp_prob, varno, TRUE);
-		}
-
-		// Make the reg variables binary
-		for (auto varno : sstate.varno_reg)
+		// Make the latency variables integers, and the reg variables binary
+		for (int col = 1; col <= n_cols; col++)
 		{
-			set_binary(lp_prob, varno, TRUE);
+			if (clp.col_is_reg[col - 1])
+				set_binary(lp_prob, col, TRUE);
+			else
+				set_int(lp_prob, col, TRUE);
 		}
 
 		// Solve and get results
@@ -770,27 +957,389 @@ namespace
 		default: break;
 		}
 
-		// Use solutions of latency variables to set latency on physical links
-		for (auto varno : sstate.varno_lat)
-		{
-			int onrows = get_Norig_rows(lp_prob);
+		std::vector<int> values(n_cols);
+		int onrows = get_Norig_rows(lp_prob);
 
+		for (int col = 1; col <= n_cols; col++)
+		{
 			// Argument to get_var is an index into a thing that is laid out as:
 			// 0 : objective function
 			// [1, nrows] : values of constraints
-			// [nrows + 1] : value of first variable (variable number 1)
-			// Since variable numbers are 1-based, take that into account.
-			int index = 1 + onrows + varno - 1;
-			unsigned latency = (unsigned)get_var_primalresult(lp_prob, index);
+			// [nrows + 1] : value of first variable (column 1)
+			int index = onrows + col;
+			values[col - 1] = (int)get_var_primalresult(lp_prob, index);
+		}
+
+		// Cleanup
+		delete_lp(lp_prob);
+
+		return values;
+	}
+
+	// Checks values against the columns' bounds and every row of the canonical MILP
+	bool is_feasible(const CanonicalLP& clp, const std::vector<int>& values)
+	{
+		if (values.size() != clp.col_varnos.size())
+			return false;
+
+		for (unsigned col = 0; col < values.size(); col++)
+		{
+			if (values[col] < 0 || (clp.col_is_reg[col] && values[col] > 1))
+				return false;
+		}
+
+		for (auto& row : clp.rows)
+		{
+			double lhs = 0;
+			for (unsigned i = 0; i < row.varnos.size(); i++)
+				lhs += row.coefs[i] * values[row.varnos[i] - 1];
+
+			switch (row.op)
+			{
+			case ROWTYPE_LE: if (lhs > row.rhs) return false; break;
+			case ROWTYPE_GE: if (lhs < row.rhs) return false; break;
+			case ROWTYPE_EQ: if (lhs != row.rhs) return false; break;
+			default: return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Value of the canonical MILP's objective for the given column values
+	double calc_cost(const CanonicalLP& clp, const std::vector<int>& values)
+	{
+		double result = 0;
+		auto& obj = clp.objective;
+		for (unsigned i = 0; i < obj.varno.size(); i++)
+			result += obj.coef[i] * values[obj.varno[i] - 1];
+
+		return result;
+	}
+
+	// The MILP usually falls apart into independent sub-problems: groups of variables
+	// that share no rows with any other group. Each is canonicalized and solved as its own
+	// model, in parallel, and each can be reused separately from earlier solves.
+	void solve_lp_constraints(SolverState& sstate)
+	{
+		auto& rows = sstate.lp_constraints;
+		int n_rows = (int)rows.size();
+		int n_cols = (int)sstate.varno_lat.size() + (int)sstate.varno_reg.size();
+
+		// Sometimes, there's just nothing to do
+		if (n_rows == 0 || n_cols == 0)
+			return;
+
+		// Variables that appear in the same row are in the same sub-problem
+		graph::DisjointSets var_sets(sstate.next_varno);
+		for (auto& row : rows)
+		{
+			for (unsigned i = 1; i < row.varnos.size(); i++)
+				var_sets.unite(row.varnos[0], row.varnos[i]);
+		}
+
+		// Number the sub-problems and give each its rows and variables.
+		// Rows without variables don't constrain anything.
+		std::unordered_map<unsigned, unsigned> set_to_comp;
+		std::vector<std::vector<unsigned>> comp_rows;
+		std::vector<std::vector<int>> comp_varnos;
+		std::vector<bool> varno_used(sstate.next_varno, false);
+
+		for (unsigned i = 0; i < rows.size(); i++)
+		{
+			if (rows[i].varnos.empty())
+				continue;
+
+			unsigned set = var_sets.find(rows[i].varnos[0]);
+			auto ins = set_to_comp.emplace(set, (unsigned)comp_rows.size());
+			if (ins.second)
+			{
+				comp_rows.emplace_back();
+				comp_varnos.emplace_back();
+			}
+
+			unsigned comp = ins.first->second;
+			comp_rows[comp].push_back(i);
+
+			for (auto varno : rows[i].varnos)
+			{
+				if (!varno_used[varno])
+				{
+					varno_used[varno] = true;
+					comp_varnos[comp].push_back(varno);
+				}
+			}
+		}
+
+		// Name the variables and look up their objective coefficients up front, so
+		// that the sub-problems only read shared state
+		auto sys = sstate.sys;
+		std::vector<std::string> var_names(sstate.next_varno);
+
+		auto name_vars = [&](const std::unordered_map<int, LinkID>& varno_to_link, char prefix)
+		{
+			for (auto& entry : varno_to_link)
+			{
+				if (!varno_used[entry.first])
+					continue;
+
+				auto link = sys->get_link(entry.second);
+				var_names[entry.first] = prefix + link->get_src()->get_hier_path(sys) +
+					" -> " + link->get_sink()->get_hier_path(sys);
+			}
+		};
+
+		name_vars(sstate.varno_lat_to_link, 'L');
+		name_vars(sstate.varno_reg_to_link, 'R');
+
+		std::vector<double> obj_coefs(sstate.next_varno, 0);
+		for (unsigned i = 0; i < sstate.lp_objective.varno.size(); i++)
+			obj_coefs[sstate.lp_objective.varno[i]] = sstate.lp_objective.coef[i];
+
+		// Solve, or reuse solutions for, each sub-problem
+		unsigned n_comps = comp_rows.size();
+		std::vector<CanonicalLP> comp_lps(n_comps);
+		std::vector<std::vector<int>> comp_values(n_comps);
+		std::vector<double> comp_secs(n_comps, -1);
+
+		// lp_solve points its BLAS routines at the built-in ones on first use. Get that
+		// done before any threads race to do it.
+		init_BLAS();
+
+		bool check = genie::impl::get_flow_options().check_latency;
+
+		parallel::for_each_index(n_comps, parallel::get_n_jobs(), [&](unsigned comp)
+		{
+			auto& clp = comp_lps[comp];
+			clp = canonicalize_lp(sstate, comp_varnos[comp], comp_rows[comp],
+				var_names, obj_coefs);
+
+			// A remembered solution is only trusted if it still satisfies every row
+			if (sstate.ctx && sstate.ctx->find_solution(clp.key, comp_values[comp]) &&
+				is_feasible(clp, comp_values[comp]))
+			{
+				// With --check_latency, it also has to be as good as a fresh solve
+				if (check)
+				{
+					double cost = calc_cost(clp, comp_values[comp]);
+					double ref_cost = calc_cost(clp, run_lp_solve(clp));
+					if (cost != ref_cost)
+					{
+						throw Exception(sys->get_hier_path() + ": reused latency solution costs " +
+							std::to_string(cost) + ", lp_solve finds " + std::to_string(ref_cost));
+					}
+				}
+
+				return;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			comp_values[comp] = run_lp_solve(clp);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			comp_secs[comp] = elapsed.count();
+
+			if (sstate.ctx)
+				sstate.ctx->add_solution(clp.key, comp_values[comp]);
+		});
+
+		// Use solutions of latency variables to set latency on physical links
+		for (unsigned comp = 0; comp < n_comps; comp++)
+		{
+			auto& clp = comp_lps[comp];
+			auto& values = comp_values[comp];
+
+			if (comp_secs[comp] < 0)
+			{
+				sstate.stats.n_reused++;
+			}
+			else
+			{
+				sstate.stats.n_lp++;
+				sstate.stats.lp_secs += comp_secs[comp];
+			}
+
+			for (unsigned col = 0; col < clp.col_varnos.size(); col++)
+			{
+				if (clp.col_is_reg[col])
+					continue;
+
+				LinkID link_id = sstate.varno_lat_to_link[clp.col_varnos[col]];
+				auto link = static_cast<LinkRSPhys*>(sys->get_link(link_id));
+				link->set_latency((unsigned)values[col]);
+			}
+		}
+
+		// Latency variables that ended up in no row are best left at zero
+		for (auto varno : sstate.varno_lat)
+		{
+			if (varno_used[varno])
+				continue;
 
-			// Set the latency of the physical link
+			LinkID link_id = sstate.varno_lat_to_link[varno];
+			static_cast<LinkRSPhys*>(sys->get_link(link_id))->set_latency(0);
+		}
+	}
+
+	// Fast path for when no register variables are needed and every constraint
+	// just bounds one latency variable or the difference of two: a system of difference
+	// constraints. Its feasible solutions are closed under componentwise min, and with
+	// positive objective weights the least solution is the optimum. That is the
+	// longest-path distance of each variable from a reference vertex pinned at 0,
+	// which Bellman-Ford finds without going near the MILP.
+	//
+	// Returns false if the fast path doesn't apply, or if the system is infeasible,
+	// in which case the caller should fall back on lp_solve.
+	bool solve_difference_constraints(SolverState& sstate)
+	{
+		// An empty constraint set still falls through to the end, so that
+		// every latency variable gets written (as 0) rather than left stale.
+		if (!sstate.varno_reg.empty())
+			return false;
+
+		for (auto coef : sstate.lp_objective.coef)
+		{
+			if (coef <= 0)
+				return false;
+		}
+
+		// Vertex 0 is the reference and the rest are latency varnos.
+		// Each edge means: dist[to] >= dist[from] + weight
+		struct DiffEdge
+		{
+			int from;
+			int to;
+			int weight;
+		};
+
+		int n_verts = sstate.next_varno;
+		std::vector<std::vector<DiffEdge>> out_edges(n_verts);
+
+		for (auto& cns : sstate.lp_constraints)
+		{
+			// Find the +1 and -1 terms, if any, and reject anything else.
+			// A missing term is the reference vertex.
+			int pos = 0;
+			int neg = 0;
+
+			for (unsigned i = 0; i < cns.coefs.size(); i++)
+			{
+				double coef = cns.coefs[i];
+				if (coef == 0)
+					continue;
+				else if (coef == 1 && pos == 0)
+					pos = cns.varnos[i];
+				else if (coef == -1 && neg == 0)
+					neg = cns.varnos[i];
+				else
+					return false;
+			}
+
+			// The constraint is now: x_pos - x_neg (op) rhs
+			if (cns.op == ROWTYPE_GE || cns.op == ROWTYPE_EQ)
+				out_edges[neg].push_back({ neg, pos, cns.rhs });
+			if (cns.op == ROWTYPE_LE || cns.op == ROWTYPE_EQ)
+				out_edges[pos].push_back({ pos, neg, -cns.rhs });
+		}
+
+		// Queue-based Bellman-Ford for longest paths. Every latency is nonnegative,
+		// so all distances start at 0 and only ever go up.
+		std::vector<int> dist(n_verts, 0);
+		std::vector<unsigned> n_updates(n_verts, 0);
+		std::vector<bool> queued(n_verts, true);
+		std::deque<int> to_visit;
+
+		for (int v = 0; v < n_verts; v++)
+			to_visit.push_back(v);
+
+		while (!to_visit.empty())
+		{
+			int u = to_visit.front();
+			to_visit.pop_front();
+			queued[u] = false;
+
+			for (auto& e : out_edges[u])
+			{
+				int d = dist[u] + e.weight;
+				if (d <= dist[e.to])
+					continue;
+
+				// The reference is pinned at 0, so raising it means some upper bound
+				// can't be met. Updating any vertex n times means a positive cycle.
+				// Either way it's infeasible.
+				if (e.to == 0 || ++n_updates[e.to] >= (unsigned)n_verts)
+					return false;
+
+				dist[e.to] = d;
+				if (!queued[e.to])
+				{
+					queued[e.to] = true;
+					to_visit.push_back(e.to);
+				}
+			}
+		}
+
+		// Use distances to set latency on physical links
+		for (auto varno : sstate.varno_lat)
+		{
 			LinkID link_id = sstate.varno_lat_to_link[varno];
 			auto link = static_cast<LinkRSPhys*>(sstate.sys->get_link(link_id));
-			link->set_latency(latency);
+			link->set_latency((unsigned)dist[varno]);
 		}
 
-		// Cleanup
-		delete_lp(lp_prob);
+		return true;
+	}
+
+	// For --check_latency. Solves the MILP again as one plain lp_solve model, without
+	// any of the shortcuts above, and makes sure the latencies already set on the links
+	// satisfy the given rows and cost the same as its optimum.
+	void check_latencies(SolverState& sstate, const std::vector<LPConstraint>& rows,
+		unsigned dom_id)
+	{
+		int n_cols = sstate.next_varno - 1;
+		if (rows.empty() || n_cols == 0)
+			return;
+
+		// Columns are just the varnos
+		CanonicalLP clp;
+		clp.rows = rows;
+		clp.objective = sstate.lp_objective;
+
+		for (int varno = 1; varno <= n_cols; varno++)
+		{
+			clp.col_varnos.push_back(varno);
+			clp.col_is_reg.push_back(sstate.varno_reg_to_link.count(varno) > 0);
+		}
+
+		auto ref_values = run_lp_solve(clp);
+
+		// Read back the latencies. A reg variable only ever appears in covering rows
+		// and under its latency variable, so it's best set whenever the latency is nonzero.
+		std::vector<int> values(n_cols, 0);
+		for (auto& entry : sstate.varno_lat_to_link)
+		{
+			auto link = static_cast<LinkRSPhys*>(sstate.sys->get_link(entry.second));
+			values[entry.first - 1] = (int)link->get_latency();
+		}
+
+		for (auto& entry : sstate.varno_reg_to_link)
+		{
+			int varno_lat = sstate.link_to_varno_lat.at(entry.second);
+			values[entry.first - 1] = values[varno_lat - 1] > 0 ? 1 : 0;
+		}
+
+		double cost = calc_cost(clp, values);
+		double ref_cost = calc_cost(clp, ref_values);
+
+		auto where = sstate.sys->get_hier_path() + " domain " + std::to_string(dom_id);
+
+		if (!is_feasible(clp, values))
+			throw Exception(where + ": latencies violate the latency constraints");
+
+		if (cost != ref_cost)
+		{
+			throw Exception(where + ": latency cost " + std::to_string(cost) +
+				" differs from lp_solve's " + std::to_string(ref_cost));
+		}
 	}
 
 	void create_obj_func(SolverState& sstate)
@@ -911,10 +1460,16 @@ namespace
 
 
 
-void flow::solve_latency_constraints(NodeSystem* sys, unsigned dom_id)
+void flow::solve_latency_constraints(NodeSystem* sys, unsigned dom_id,
+	LatencySolverContext* lat_ctx)
 {
 	SolverState sstate;
 	sstate.sys = sys;
+	sstate.ctx = lat_ctx;
+	sstate.stats.n_solves = 1;
+
+	// Relations are only read from here on
+	sys->get_link_relations().freeze();
 
 	// Latency-related
 	process_sync_constraints(sstate);
@@ -925,6 +1480,14 @@ void flow::solve_latency_constraints(NodeSystem* sys, unsigned dom_id)
 	postprocess_reg_graph(sstate);
 	create_reg_constraints(sstate);
 
+	// Checked against all rows, including the ones about to be dropped
+	bool check = genie::impl::get_flow_options().check_latency;
+	std::vector<LPConstraint> all_rows;
+	if (check)
+		all_rows = sstate.lp_constraints;
+
+	remove_redundant_constraints(sstate);
+
 	// Objective function
 	create_obj_func(sstate);
 	
@@ -933,7 +1496,79 @@ void flow::solve_latency_constraints(NodeSystem* sys, unsigned dom_id)
 		dump_reg_graph(sstate, dom_id);
 	}
 
-	// Solve and annotate latencies
-	solve_lp_constraints(sstate);
+	// Solve and annotate latencies. The MILP is only needed if the
+	// shortest-path solver can't handle it.
+	if (solve_difference_constraints(sstate))
+		sstate.stats.n_diff++;
+	else
+		solve_lp_constraints(sstate);
+
+	if (check)
+		check_latencies(sstate, all_rows, dom_id);
+
+	if (lat_ctx)
+		lat_ctx->add_stats(sstate.stats);
+}
+
+//
+// LatencySolverContext
+//
+
+bool LatencySolverContext::find_solution(const std::string& problem,
+	std::vector<int>& values)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_solution_index.find(problem);
+	if (it == m_solution_index.end())
+		return false;
+
+	// Mark as most recently used
+	m_solutions.splice(m_solutions.begin(), m_solutions, it->second);
+
+	values = it->second->second;
+	return true;
+}
+
+void LatencySolverContext::add_solution(const std::string& problem,
+	const std::vector<int>& values)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Another thread may have solved the same problem in the meantime
+	auto it = m_solution_index.find(problem);
+	if (it != m_solution_index.end())
+	{
+		it->second->second = values;
+		m_solutions.splice(m_solutions.begin(), m_solutions, it->second);
+		return;
+	}
+
+	if (m_solutions.size() >= MAX_SOLUTIONS)
+	{
+		m_solution_index.erase(m_solutions.back().first);
+		m_solutions.pop_back();
+	}
+
+	m_solutions.emplace_front(problem, values);
+	m_solution_index[problem] = m_solutions.begin();
+}
+
+void LatencySolverContext::add_stats(const Stats& stats)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_stats.n_solves += stats.n_solves;
+	m_stats.n_diff += stats.n_diff;
+	m_stats.n_lp += stats.n_lp;
+	m_stats.n_reused += stats.n_reused;
+	m_stats.n_rows_removed += stats.n_rows_removed;
+	m_stats.lp_secs += stats.lp_secs;
+}
+
+LatencySolverContext::Stats LatencySolverContext::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
 }
 
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "genie/log.h"
+#include <mutex>
 
 using namespace genie;
 using namespace genie::log;
@@ -25,15 +26,26 @@ namespace
 
     Handler s_handler = default_handler;
 
+    // Serializes calls to the handler when messages come from worker threads.
+    // Also guards buffers, which can be shared by several threads.
+    std::mutex s_mutex;
+
+    thread_local Buffer* t_buffer = nullptr;
+
     void msg_internal(Message::Level lvl, const char* fmt, va_list vl)
     {
-        static char buf[4096];
+        char buf[4096];
 
         vsnprintf(buf, sizeof(buf), fmt, vl);
         Message msg;
         msg.level = lvl;
         msg.msg = std::string(buf);
-        s_handler(msg);
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (t_buffer)
+            t_buffer->push_back(std::move(msg));
+        else
+            s_handler(msg);
     }
 }
 
@@ -42,6 +54,28 @@ void log::set_handler(const Handler& h)
     s_handler = h;
 }
 
+Buffer* log::set_thread_buffer(Buffer* buf)
+{
+    Buffer* prev = t_buffer;
+    t_buffer = buf;
+    return prev;
+}
+
+Buffer* log::get_thread_buffer()
+{
+    return t_buffer;
+}
+
+void log::flush(Buffer& buf)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    for (auto& msg : buf)
+        s_handler(msg);
+
+    buf.clear();
+}
+
 void log::msg(Message::Level lvl, const char* fmt, ...)
 {
     va_list vl;
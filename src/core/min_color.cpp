@@ -57,4 +57,4 @@ int graph::connected_comp(Graph& g, V2Attr<unsigned>* vcolor, E2Attr<unsigned>*
 		delete vcolor;
 
 	return colors;
-}
\ No newline at end of file
+}
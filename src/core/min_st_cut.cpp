@@ -2,179 +2,348 @@
 #include "graph.h"
 
 using namespace genie::impl;
+using namespace genie::impl::graph;
 
-// Given an undirected graph G with edge weights stored in 'cap', this finds the minimal-weight
-// graph cut between vertices s and t.
-//
-// Graph G is modified to remove the edges of the cut, and the total weight of the cut (sum of the
-// weights of the removed edges) is returned.
-
-int graph::min_st_cut(Graph& G, E2Attr<int> cap, VertexID s, VertexID t)
+namespace
 {
-	// R is G but with each undirected edge {u,v} converted into two directed edges (u,v) and (v,u).
-	// It is the 'residual' graph that gets continually updated by the algorithm as edges get removed.
-	Graph R = G;
-	
-	// turn undirected graph g into a directed graph by treating each existing edge as directed
-	// and creating a duplicate edge in the opposite direction - with the same capacity/weight
-	for (EdgeID e : G.edges())
+	// Push-relabel max-flow on an undirected graph, using highest-label vertex selection
+	// and the gap heuristic.
+	//
+	// Each undirected edge e becomes two arcs: 2e (src->sink) and 2e+1 (sink->src), each
+	// with the edge's full capacity. Pushing flow over an arc uses up its residual capacity
+	// and adds to its partner's (arc ^ 1).
+	//
+	// It runs on a view of the graph given by 'vmap', which renumbers g's vertices
+	// 0..n_view-1. Vertices mapped to INVALID_V are left out, and vertices mapped to the
+	// same number are contracted into one, with edges between them disappearing.
+	class PushRelabel
 	{
-		// grab the pair of vertices of each edge and swap them to create the reverse edge
-		auto vs = G.verts(e);
-		EdgeID newe = R.newe(vs.second, vs.first);
+	public:
+		PushRelabel(const CSRGraph& g, const EArray<int>& cap,
+			const VArray<VertexID>& vmap, unsigned n_view)
+			: m_n(n_view)
+		{
+			auto keep = [&](EdgeID e)
+			{
+				auto vs = g.verts(e);
+				return vs.first != INVALID_V && vs.second != INVALID_V &&
+					vmap[vs.first] != INVALID_V && vmap[vs.second] != INVALID_V &&
+					vmap[vs.first] != vmap[vs.second];
+			};
 
-		// update our copy of the capacities map to include a capacity for this new edge
-		cap[newe] = cap[e];
-	}
+			// Arcs leaving each view vertex, stored contiguously: count, then fill
+			m_arc_offs.assign(m_n + 1, 0);
+			for (EdgeID e = 0; e < g.n_edges(); e++)
+			{
+				if (!keep(e))
+					continue;
 
-	// while a path exists from s to t with >0 residual capacity, use up capacity on that path.
-	V2Attr<bool> visited;
-	while(true)
-	{
-		// This makes sure we only visit each vertex once during depth-first traversal.
-		// The map is declared outside the loop for performance
-		for (VertexID v : R.verts())
-		{
-			visited[v] = false;
-		}
+				auto vs = g.verts(e);
+				m_arc_offs[vmap[vs.first] + 1]++;
+				m_arc_offs[vmap[vs.second] + 1]++;
+			}
 
-		// Do a depth-first search from s to t to find an augmenting path
-		std::vector<VertexID> path;
-		path.push_back(s);
+			for (unsigned v = 1; v <= m_n; v++)
+				m_arc_offs[v] += m_arc_offs[v - 1];
+
+			std::vector<unsigned> pos(m_arc_offs.begin(), m_arc_offs.end() - 1);
+			m_arcs.resize(m_arc_offs.back());
+			m_head.resize(2 * g.n_edges());
+			m_res.resize(2 * g.n_edges());
+
+			for (EdgeID e = 0; e < g.n_edges(); e++)
+			{
+				if (!keep(e))
+					continue;
 
-		while(!path.empty())
+				auto vs = g.verts(e);
+				VertexID v1 = vmap[vs.first];
+				VertexID v2 = vmap[vs.second];
+
+				m_arcs[pos[v1]++] = 2 * e;
+				m_arcs[pos[v2]++] = 2 * e + 1;
+				m_head[2 * e] = v2;
+				m_head[2 * e + 1] = v1;
+				m_res[2 * e] = cap[e];
+				m_res[2 * e + 1] = cap[e];
+			}
+		}
+
+		// Pushes as much flow as possible from s to t and returns the amount.
+		// Excess that can't reach t is returned to s, leaving a proper flow.
+		int run(VertexID s, VertexID t)
 		{
-			VertexID cur_v = path.back();
-			visited[cur_v] = true;
+			m_height.assign(m_n, 0);
+			m_excess.assign(m_n, 0);
+			m_cur.assign(m_arc_offs.begin(), m_arc_offs.end() - 1);
+			m_count.assign(2 * m_n + 1, 0);
+			m_buckets.assign(2 * m_n + 1, VList());
+			m_max_active = 0;
 
-			// We've reached the the end of the path, t
-			if (cur_v == t)
-				break;
+			init_heights(s, t);
 
-			// Follow edges that have nonzero remaining capacity
-			bool found = false;
-			for (EdgeID e : R.edges(cur_v))
+			// Saturate everything leaving s
+			for (unsigned i = m_arc_offs[s]; i < m_arc_offs[s + 1]; i++)
 			{
-				VPair ev = R.verts(e);
+				unsigned arc = m_arcs[i];
+				int amt = m_res[arc];
+				VertexID w = m_head[arc];
 
-				// To do this, each edge of cur_v must:
-				// - be directed away from cur_v to the other vertex
-				// - have nonzero remaining capacity
-				// - point to a vertex that's unvisited
-				if (cap[e] > 0 && cur_v == ev.first && !visited[ev.second])
-				{
-					found = true;
-					path.push_back(ev.second);
+				if (amt == 0)
+					continue;
+
+				m_res[arc] -= amt;
+				m_res[arc ^ 1] += amt;
+				m_excess[s] -= amt;
+				m_excess[w] += amt;
+
+				if (w != t && m_excess[w] == amt)
+					activate(w);
+			}
+
+			// Discharge active vertices, highest first
+			while (true)
+			{
+				while (m_max_active > 0 && m_buckets[m_max_active].empty())
+					m_max_active--;
+
+				if (m_buckets[m_max_active].empty())
 					break;
-				}
+
+				VertexID v = m_buckets[m_max_active].back();
+				m_buckets[m_max_active].pop_back();
+
+				if (v != s && v != t)
+					discharge(v);
 			}
 
-			if (!found)
+			return m_excess[t];
+		}
+
+		// Marks the vertices reachable from s through arcs with remaining capacity.
+		// After run(), this is the source side of a minimum cut.
+		void source_side(VertexID s, VArray<bool>& result) const
+		{
+			result.assign(m_n, false);
+			result[s] = true;
+			VList to_visit{ s };
+
+			while (!to_visit.empty())
 			{
-				// Backtrack
-				path.pop_back();
+				VertexID v = to_visit.back();
+				to_visit.pop_back();
+
+				for (unsigned i = m_arc_offs[v]; i < m_arc_offs[v + 1]; i++)
+				{
+					unsigned arc = m_arcs[i];
+					VertexID w = m_head[arc];
+
+					if (m_res[arc] > 0 && !result[w])
+					{
+						result[w] = true;
+						to_visit.push_back(w);
+					}
+				}
 			}
 		}
 
-		// Found a path?
-		if (!path.empty())
+	private:
+		void init_heights(VertexID s, VertexID t)
 		{
-			// Traverse the path to find minimum residual capacity
-			int mincap = std::numeric_limits<int>::max();
-			VertexID v1 = path[0];
-			for (unsigned int i = 1; i < path.size(); i++)
+			// Exact distances to t in the residual graph, by breadth-first search
+			// backwards from t. Vertices that can't reach t start at n.
+			const unsigned UNSET = std::numeric_limits<unsigned>::max();
+			std::vector<unsigned> dist(m_n, UNSET);
+			VList queue{ t };
+			dist[t] = 0;
+
+			for (unsigned qi = 0; qi < queue.size(); qi++)
 			{
-				VertexID v2 = path[i];
-				EdgeID e = R.dir_edge(v1, v2);
-				mincap = std::min(mincap, cap[e]);
-				v1 = v2;
+				VertexID w = queue[qi];
+				for (unsigned i = m_arc_offs[w]; i < m_arc_offs[w + 1]; i++)
+				{
+					// The arc into w is the partner of this one
+					unsigned arc = m_arcs[i];
+					VertexID v = m_head[arc];
+					if (dist[v] == UNSET && v != s && m_res[arc ^ 1] > 0)
+					{
+						dist[v] = dist[w] + 1;
+						queue.push_back(v);
+					}
+				}
 			}
 
-			// Adjust residual capacities along path. The edges that had mincap as their cap
-			// will now have 0.
-			v1 = path[0];
-			for (unsigned int i = 1; i < path.size(); i++)
+			for (VertexID v = 0; v < m_n; v++)
 			{
-				VertexID v2 = path[i];
-				EdgeID e1 = R.dir_edge(v1, v2);
-				EdgeID e2 = R.dir_edge(v2, v1);
-
-				// Forward edge gets reduced capacity, backwards edge gets increased capacity.
-				// This is the trick that allows us to use this algorithm with undirected graphs.
-				cap[e1] -= mincap;
-				cap[e2] += mincap;
-				v1 = v2;
+				m_height[v] = v == s ? m_n : (dist[v] == UNSET ? m_n : dist[v]);
+				m_count[m_height[v]]++;
 			}
 		}
-		else
+
+		void activate(VertexID v)
 		{
-			// no path found? done
-			break;
+			unsigned h = m_height[v];
+			m_buckets[h].push_back(v);
+			m_max_active = std::max(m_max_active, h);
 		}
-	}
 
-	// Remove all zero-weight edges (and their corresponding back-edges) from R.
-	// Iterate over edges in G so that 'e' is always an existing forward edge (existing in both
-	// G and R) and e2 is a backward edge (existing and only introduced in R).
-	//
-	// Also, update the capacity of each forward edge 'e' to be the original cost
-	for (EdgeID e : G.iter_edges)
-	{
-		EdgeID e2 = R.redge(e);
-		int cap_e = cap[e];
-		int cap_e2 = cap[e2];
+		void discharge(VertexID v)
+		{
+			while (m_excess[v] > 0)
+			{
+				if (m_cur[v] == m_arc_offs[v + 1])
+				{
+					relabel(v);
+					continue;
+				}
 
-		if (cap_e == 0 || cap_e2 == 0)
+				unsigned arc = m_arcs[m_cur[v]];
+				VertexID w = m_head[arc];
+
+				if (m_res[arc] > 0 && m_height[v] == m_height[w] + 1)
+				{
+					int amt = std::min(m_excess[v], m_res[arc]);
+					bool was_inactive = m_excess[w] == 0;
+
+					m_res[arc] -= amt;
+					m_res[arc ^ 1] += amt;
+					m_excess[v] -= amt;
+					m_excess[w] += amt;
+
+					if (was_inactive)
+						activate(w);
+				}
+				else
+				{
+					m_cur[v]++;
+				}
+			}
+		}
+
+		void relabel(VertexID v)
 		{
-			R.dele(e);
-			R.dele(e2);
+			unsigned old_h = m_height[v];
+			unsigned new_h = 2 * m_n;
+
+			for (unsigned i = m_arc_offs[v]; i < m_arc_offs[v + 1]; i++)
+			{
+				unsigned arc = m_arcs[i];
+				if (m_res[arc] > 0)
+					new_h = std::min(new_h, m_height[m_head[arc]] + 1);
+			}
+
+			m_count[old_h]--;
+			m_cur[v] = m_arc_offs[v];
 
-			// This works because either cap_e or cap_e2 is 0, and the other is equal to
-			// the original weight * 2.
-			cap[e] = (cap_e + cap_e2) / 2;
+			// Gap: if nothing is left at v's old height (below n), nothing at or above it
+			// can reach t anymore. Lift them all above n so their excess goes back to s.
+			if (old_h < m_n && m_count[old_h] == 0)
+			{
+				for (VertexID u = 0; u < m_n; u++)
+				{
+					if (m_height[u] > old_h && m_height[u] < m_n)
+					{
+						m_count[m_height[u]]--;
+						m_height[u] = m_n + 1;
+						m_count[m_height[u]]++;
+						m_cur[u] = m_arc_offs[u];
+					}
+				}
+
+				new_h = std::max(new_h, m_n + 1);
+			}
+
+			m_height[v] = new_h;
+			m_count[new_h]++;
 		}
+
+		unsigned m_n;
+		std::vector<unsigned> m_arc_offs;
+		std::vector<unsigned> m_arcs;
+		VList m_head;
+		std::vector<int> m_res;
+
+		std::vector<unsigned> m_height;
+		std::vector<int> m_excess;
+		std::vector<unsigned> m_cur;
+		std::vector<unsigned> m_count;
+		std::vector<VList> m_buckets;
+		unsigned m_max_active;
+	};
+}
+
+// Given an undirected graph G with edge weights stored in 'cap', this finds the minimal-weight
+// graph cut between vertices s and t.
+//
+// Graph G is modified to remove the edges of the cut, and the total weight of the cut (sum of the
+// weights of the removed edges) is returned.
+int graph::min_st_cut(Graph& G, E2Attr<int> cap, VertexID s, VertexID t)
+{
+	// Work on a CSR version of G, then remove the cut edges from G itself
+	CSRGraph csr(G);
+	EArray<bool> cut_edges;
+
+	int result = min_st_cut(csr, csr.to_earray(cap), csr.to_v(s), csr.to_v(t), &cut_edges);
+
+	for (EdgeID e = 0; e < csr.n_edges(); e++)
+	{
+		if (cut_edges[e])
+			G.dele(csr.orig_e(e));
 	}
 
-	// Find all vertices reachable from s in R
-	auto reachable = R.connected_verts(s);
-	std::unordered_set<VertexID> reachable_set(reachable.begin(), reachable.end());
+	return result;
+}
 
-	// Find the edges in G that comprise the min-cut.
-	// Return the total sum of their weights.
-	// Remove those edges from G.
-	//
-	// A cut edge is an edge e=(u,v) in G such that satisfies both:
-	//	 - either v or u is reachable from terminal vertex s
-	//   - either e itself or e2(v,u) does not exist in R
-	//
-	// This represents edges that have zero residual capacity (in either the forward or backward
-	// direction) and that lie on the boundary of the cut (one vertex still reachable from s)
+// Same as above, for CSR graphs. The graph can't be modified, so the edges making up
+// the cut are flagged in 'cut_edges' instead, if it's not null.
+//
+// The cut's source side is everything still reachable from s once the maximum flow
+// is in place. This is the smallest possible source side, so the cut is the same no matter
+// how the flow was found.
+int graph::min_st_cut(const CSRGraph& G, const EArray<int>& cap, VertexID s, VertexID t,
+	EArray<bool>* cut_edges)
+{
+	VArray<VertexID> identity(G.n_verts());
+	for (VertexID v = 0; v < G.n_verts(); v++)
+		identity[v] = v;
+
+	VArray<bool> s_side;
+	min_st_cut(G, cap, identity, G.n_verts(), s, t, &s_side);
+
+	if (cut_edges)
+		cut_edges->assign(G.n_edges(), false);
 
 	int result = 0;
-	auto g_edges = G.edges();
-	for (EdgeID e_g : g_edges)
+	for (EdgeID e = 0; e < G.n_edges(); e++)
 	{
-		VPair verts = G.verts(e_g);
-
-		// Only consider edges in G that have at least one vertex in the reachable set
-		if (!reachable_set.count(verts.first) && !reachable_set.count(verts.second))
+		auto vs = G.verts(e);
+		if (vs.first == INVALID_V || vs.second == INVALID_V)
 			continue;
 
-		// Try to get edges (u,v) and (v,u) in R
-		EdgeID e_r1 = R.dir_edge(verts.first, verts.second);
-		EdgeID e_r2 = R.dir_edge(verts.second, verts.first);
-
-		// If either one is missing in R, then this is a cut edge
-		if (e_r1 == INVALID_E || e_r2 == INVALID_E)
+		if (s_side[vs.first] != s_side[vs.second])
 		{
-			// Add the original capacity of the edge in G to the total cut weight.
-			result += cap[e_g];
-
-			// Remove the edge from the original input graph. This is the only place where
-			// G is modified. 
-			G.dele(e_g);
+			result += cap[e];
+			if (cut_edges) (*cut_edges)[e] = true;
 		}
-	}	
+	}
+
+	return result;
+}
+
+// Same as above, on a view of G where vertices are renumbered 0..n_view-1 by 'vmap'.
+// Vertices mapped to INVALID_V are left out, and vertices mapped to the same number are
+// contracted into one. This avoids building a modified copy of G. 's' and 't' are view
+// vertex numbers, and the source side of the cut, in view numbering, goes into 's_side'
+// if it's not null.
+int graph::min_st_cut(const CSRGraph& G, const EArray<int>& cap,
+	const VArray<VertexID>& vmap, unsigned n_view, VertexID s, VertexID t,
+	VArray<bool>* s_side)
+{
+	PushRelabel engine(G, cap, vmap, n_view);
+	int result = engine.run(s, t);
+
+	if (s_side)
+		engine.source_side(s, *s_side);
 
 	return result;
 }
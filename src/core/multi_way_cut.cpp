@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "graph.h"
+#include "parallel.h"
 
 using namespace genie::impl;
 using namespace genie::impl::graph;
@@ -12,96 +13,121 @@ using namespace genie::impl::graph;
 // specified by the ID of the vertex from T associated with that partition.
 V2Attr<VertexID> graph::multi_way_cut(Graph G, const E2Attr<int>& weights, VList T)
 {
+	// Work on a CSR version of G and convert the results back
+	CSRGraph csr(G);
+
+	for (auto& t : T)
+		t = csr.to_v(t);
+
+	auto csr_result = multi_way_cut(csr, csr.to_earray(weights), T);
+
 	V2Attr<VertexID> result;
+	for (VertexID v = 0; v < csr.n_verts(); v++)
+		result[csr.orig_v(v)] = csr.orig_v(csr_result[v]);
+
+	return result;
+}
+
+// Same as above, for CSR graphs.
+//
+// This is the isolating cut heuristic: each round, every remaining terminal is cut away
+// from all the others (merged into one vertex), the cheapest of these cuts is kept, and
+// that terminal's side is removed from the graph. The cuts within a round are independent
+// and run concurrently, each on its own view of the shared graph with the other terminals
+// contracted, rather than on a copy.
+VArray<VertexID> graph::multi_way_cut(const CSRGraph& G, const EArray<int>& weights, const VList& terminals)
+{
+	unsigned n_verts = G.n_verts();
+	VArray<VertexID> result(n_verts, INVALID_V);
+	VList T = terminals;
+
+	struct Cut
+	{
+		int weight;
+		VList side;
+	};
 
-	// until nterminals == 1
 	while (T.size() > 1)
 	{
-		typedef std::pair<int, Graph> CutType;
-		typedef std::unordered_map<VertexID, CutType>::value_type CutType2;
-		std::unordered_map<VertexID, CutType> cuts;
+		unsigned n_T = (unsigned)T.size();
+		std::vector<Cut> cuts(n_T);
+
+		// Shared by all the views this round
+		VArray<bool> is_terminal(n_verts, false);
+		for (auto t : T)
+			is_terminal[t] = true;
 
-		// for each terminal
-		for(auto& t : T)
+		parallel::for_each_index(n_T, parallel::get_n_jobs(), [&](unsigned t_idx)
 		{
-			auto& entry = cuts[t];
-			Graph& H = entry.second; 
-			int& cut_weight = entry.first;
-
-			// duplicate graph
-			H = G;
-
-			// collect all other terminal vertices
-			VList otherT = T;
-			otherT.erase(std::find(otherT.begin(), otherT.end(), t));
-			
-			// choose an s from otherT and merge all the terminals in otherT into it
-			VertexID s = otherT[0];
-			for (unsigned int i = 1; i < otherT.size(); i++)
-			{
-				H.mergev(otherT[i], s);
-			}
+			VertexID t = T[t_idx];
+
+			// Number the unpartitioned vertices, with all the other terminals sharing one number
+			VArray<VertexID> vmap(n_verts, INVALID_V);
+			VList view_to_g;
+			VertexID s = INVALID_V;
 
-			// Merge multiple edges between vertices v1,v2 into one edge with combined weight
-			auto merged_weights = weights;
-			for (auto& v : H.verts())
+			for (VertexID v = 0; v < n_verts; v++)
 			{
-				VList neigh = H.neigh(v);
-				for (auto& u : neigh)
+				if (result[v] != INVALID_V)
+					continue;
+
+				bool other_terminal = v != t && is_terminal[v];
+				if (other_terminal && s != INVALID_V)
 				{
-					EList edges = H.edges(u, v);
-					EdgeID e1 = edges[0];
-					for (unsigned int i = 1; i < edges.size(); i++)
-					{
-						EdgeID e2 = edges[i];
-						merged_weights[e1] += merged_weights[e2];
-						H.dele(e2);
-					}
+					vmap[v] = s;
+					continue;
 				}
+
+				vmap[v] = (VertexID)view_to_g.size();
+				view_to_g.push_back(v);
+
+				if (other_terminal)
+					s = vmap[v];
 			}
-			
-			/*
-			H.dump("H" + std::to_string(t), [&](EdgeID e) 
-			{ 
-				return std::to_string(merged_weights[e]); 
-			});
-			*/
-
-			// call st mincut with s,t on H and get: total weight, residue grpah
-			cut_weight = min_st_cut(H, merged_weights, t, s);
-
-			// results are remembered in cuts map
-		}
 
-		// Find minimum s-t mincut
-		auto smallest_cut = std::min_element(cuts.begin(), cuts.end(), 
-			[](const CutType2& lhs, const CutType2& rhs) { return lhs.second.first < rhs.second.first; }
-			);
-		
-		// The terminal vertex for the minimum mincut, and the residual graph
-		VertexID min_terminal = smallest_cut->first;
-		Graph& R = smallest_cut->second.second;
-		
-		// Find all vertices connected to min_terminal in R (including min_terminal itself)
-		VList connected = R.connected_verts(min_terminal);
-
-		// For all those connected vertices, paint them as belonging to the terminal vertex min_terminal
-		// Also: remove them from G (our copy) permanently
-		for (auto v : connected)
+			// Cut t from the rest, and find what's on t's side
+			VArray<bool> t_side;
+			auto& cut = cuts[t_idx];
+			cut.weight = min_st_cut(G, weights, vmap, (unsigned)view_to_g.size(),
+				vmap[t], s, &t_side);
+
+			for (VertexID hv = 0; hv < view_to_g.size(); hv++)
+			{
+				if (t_side[hv])
+					cut.side.push_back(view_to_g[hv]);
+			}
+		});
+
+		// Find the cheapest cut. Among equally cheap ones, take the one that cuts off the
+		// fewest vertices, and after that the latest terminal. This picks the same
+		// partitions as the original Graph-based implementation did.
+		unsigned min_idx = 0;
+		for (unsigned i = 1; i < n_T; i++)
 		{
-			result[v] = min_terminal;
-			G.delv(v);
+			auto& cut = cuts[i];
+			auto& min_cut = cuts[min_idx];
+
+			if (cut.weight < min_cut.weight ||
+				(cut.weight == min_cut.weight && cut.side.size() <= min_cut.side.size()))
+			{
+				min_idx = i;
+			}
 		}
 
-		// Remove terminal min_terminal from the list of terminals
-		T.erase(std::find(T.begin(), T.end(), min_terminal));
+		// Paint the minimum cut's side as belonging to its terminal
+		VertexID min_terminal = T[min_idx];
+		for (auto v : cuts[min_idx].side)
+			result[v] = min_terminal;
+
+		T.erase(T.begin() + min_idx);
 	}
 
 	// Only one terminal left - assign remaining vertices to this terminal
-	for (auto& v : G.verts())
+	for (VertexID v = 0; v < n_verts; v++)
 	{
-		result[v] = T.front();
+		if (result[v] == INVALID_V)
+			result[v] = T.front();
 	}
 
 	return result;
-}
\ No newline at end of file
+}
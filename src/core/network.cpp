@@ -12,24 +12,34 @@ using Dir = genie::Port::Dir;
 // LinkID
 //
 
-void LinkID::set_index(uint16_t idx)
+constexpr unsigned LinkID::TYPE_BITS;
+constexpr unsigned LinkID::INDEX_BITS;
+constexpr uint32_t LinkID::INDEX_MASK;
+constexpr uint32_t LinkID::MAX_INDEX;
+constexpr uint32_t LinkID::TYPE_INVALID;
+
+void LinkID::set_index(uint32_t idx)
 {
-	_id = (_id & 0xFFFF0000U) | idx;
+	assert(idx <= MAX_INDEX);
+	_id = (_id & ~INDEX_MASK) | idx;
 }
 
-uint16_t LinkID::get_index() const
+uint32_t LinkID::get_index() const
 {
-	return (uint16_t)(_id & 0xFFFFU);
+	return _id & INDEX_MASK;
 }
 
 void LinkID::set_type(NetType type)
 {
-	_id = (_id & 0xFFFFU) | (type << 16U);
+	uint32_t field = type == NET_INVALID ? TYPE_INVALID : type;
+	assert(field <= TYPE_INVALID);
+	_id = (_id & INDEX_MASK) | (field << INDEX_BITS);
 }
 
 NetType LinkID::get_type() const
 {
-	return (NetType)(_id >> 16U);
+	uint32_t field = _id >> INDEX_BITS;
+	return field == TYPE_INVALID ? NET_INVALID : (NetType)field;
 }
 
 bool LinkID::operator<(const LinkID & o) const
@@ -62,19 +72,40 @@ LinkID::operator uint32_t() const
 //
 
 LinksContainer::LinksContainer()
-	: m_type(NET_INVALID), m_next_id(0)
+	: m_type(NET_INVALID), m_next_id(0), m_recycle_floor(0)
 {
 }
 
 LinkID LinksContainer::insert_new(Link *link)
 {
-	auto index = m_next_id++;
+	// Reuse the index of a removed link if possible. Skip over any that
+	// have since been taken by insert_existing.
+	uint32_t index = LinkID::MAX_INDEX;
+	while (!m_free_ids.empty() && index == LinkID::MAX_INDEX)
+	{
+		auto free_index = m_free_ids.back();
+		m_free_ids.pop_back();
+
+		if (m_links[free_index] == nullptr)
+			index = free_index;
+	}
+
+	if (index == LinkID::MAX_INDEX)
+	{
+		if (m_next_id >= LinkID::MAX_INDEX)
+			throw Exception("too many links in network " + get_network(m_type)->get_name());
+
+		index = m_next_id++;
+	}
+
 	LinkID result(m_type, index);
 	link->set_id(result);
 
 	ensure_size_for_index(index);
 	m_links[index] = link;
 
+	if (m_index) m_index->add_link(link);
+
 	return result;
 }
 
@@ -92,7 +123,9 @@ void LinksContainer::insert_existing(Link *link)
 	assert(val_at_pos == nullptr);	// make sure this ID isn't taken by an existing link
 	val_at_pos = link;
 
-	m_next_id = std::max(m_next_id + 1, index + 1);
+	if (m_index) m_index->add_link(link);
+
+	m_next_id = std::max(m_next_id, index + 1);
 }
 
 std::vector<Link*> LinksContainer::move_new_from(LinksContainer &o)
@@ -120,8 +153,14 @@ std::vector<Link*> LinksContainer::move_new_from(LinksContainer &o)
 	// Shrink other
 	o.m_links.resize(my_size);
 
-	// Update ID
-	m_next_id = (uint16_t)new_size;
+	// Update ID. Moved-in indices are all new, so nothing can be recycled across the move.
+	m_next_id = (uint32_t)new_size;
+	m_free_ids.clear();
+	o.m_free_ids.clear();
+
+	// Links changed owners and both sets of indices shifted
+	if (o.m_index) o.m_index->rebuild(o.m_links);
+	if (m_index) m_index->rebuild(m_links);
 
 	return result;
 }
@@ -131,6 +170,58 @@ void LinksContainer::prepare_for_copy(const LinksContainer &o)
 	m_next_id = o.m_next_id;
 	if (m_next_id >= m_links.size())
 		m_links.resize(m_next_id + 1, nullptr);
+
+	// Indices up to here belong to the original too
+	m_recycle_floor = m_next_id;
+	m_free_ids.clear();
+}
+
+uint32_t LinksContainer::pin_ids()
+{
+	// The caller is remembering the current next index. Stop recycling anything below it,
+	// so that every link created from now on gets an index at or above it.
+	m_recycle_floor = m_next_id;
+	m_free_ids.clear();
+	return m_next_id;
+}
+
+void LinksContainer::rebase(uint32_t old_base, uint32_t new_base)
+{
+	// Shift all links with indices at or above old_base upwards, so that
+	// they start at new_base instead, and update their IDs.
+	assert(new_base >= old_base);
+	if (new_base == old_base)
+		return;
+
+	if (m_links.size() > old_base)
+	{
+		std::vector<Link*> moved(m_links.begin() + old_base, m_links.end());
+		m_links.resize(old_base);
+		m_links.resize(new_base, nullptr);
+
+		for (auto link : moved)
+		{
+			if (link)
+				link->set_id(LinkID(m_type, (uint32_t)m_links.size()));
+
+			m_links.push_back(link);
+		}
+	}
+
+	if (m_next_id >= old_base)
+		m_next_id += new_base - old_base;
+
+	if (m_recycle_floor >= old_base)
+		m_recycle_floor += new_base - old_base;
+
+	for (auto& free_id : m_free_ids)
+	{
+		if (free_id >= old_base)
+			free_id += new_base - old_base;
+	}
+
+	// Edges are numbered by link index, which just changed
+	if (m_index) m_index->rebuild(m_links);
 }
 
 Link * LinksContainer::get(LinkID id)
@@ -145,6 +236,12 @@ Link * LinksContainer::remove(LinkID id)
 	auto where = m_links.begin() + idx;
 	auto result = *where;
 	*where = nullptr; // leave gap in vector
+
+	if (m_index && result) m_index->remove_link(result);
+
+	// Let the gap be filled by a future link, if nobody else can know about this ID
+	if (result && idx >= m_recycle_floor)
+		m_free_ids.push_back(idx);
 	
 	return result;
 }
@@ -172,7 +269,16 @@ void LinksContainer::get_all_internal(void * pout, const ThuncFunc &thunc) const
 	}
 }
 
-void LinksContainer::ensure_size_for_index(uint16_t index)
+void LinksContainer::enable_index()
+{
+	if (m_index)
+		return;
+
+	m_index.reset(new NetIndex);
+	m_index->rebuild(m_links);
+}
+
+void LinksContainer::ensure_size_for_index(uint32_t index)
 {
 	// expand the vector if need be, and fill
 	// new entries with nulls
@@ -184,6 +290,138 @@ void LinksContainer::ensure_size_for_index(uint16_t index)
 }
 
 
+//
+// NetIndex
+//
+
+void NetIndex::add_link(Link* link)
+{
+	graph::EdgeID e = link->get_id().get_index();
+	if (e >= m_e_to_link.size())
+	{
+		m_e_to_link.resize(e + 1, nullptr);
+		m_ends.resize(e + 1, graph::VPair(graph::INVALID_V, graph::INVALID_V));
+	}
+
+	assert(!m_e_to_link[e]);
+	m_e_to_link[e] = link;
+	link->set_net_index(this);
+	set_ends(e, link);
+}
+
+void NetIndex::remove_link(Link* link)
+{
+	graph::EdgeID e = link->get_id().get_index();
+	assert(e < m_e_to_link.size() && m_e_to_link[e] == link);
+
+	m_e_to_link[e] = nullptr;
+	link->set_net_index(nullptr);
+	set_ends(e, nullptr);
+}
+
+void NetIndex::update_link(Link* link)
+{
+	set_ends(link->get_id().get_index(), link);
+}
+
+void NetIndex::rebuild(const std::vector<Link*>& links)
+{
+	m_obj_to_v.clear();
+	m_v_to_obj.clear();
+	m_v_refs.clear();
+	m_free_verts.clear();
+	m_e_to_link.clear();
+	m_ends.clear();
+	m_graph_valid = false;
+
+	for (auto link : links)
+	{
+		if (link)
+		{
+			link->set_net_index(nullptr);
+			add_link(link);
+		}
+	}
+}
+
+graph::VertexID NetIndex::get_vertex(HierObject* obj) const
+{
+	auto it = m_obj_to_v.find(obj);
+	return it == m_obj_to_v.end() ? graph::INVALID_V : it->second;
+}
+
+const graph::CSRGraph& NetIndex::get_graph()
+{
+	if (!m_graph_valid)
+	{
+		// Gaps and half-connected links have INVALID_V ends and are left out of the adjacency
+		m_graph = graph::CSRGraph(n_verts(), m_ends);
+		m_graph_valid = true;
+	}
+
+	return m_graph;
+}
+
+graph::VertexID NetIndex::ref_vertex(HierObject* obj)
+{
+	auto it = m_obj_to_v.find(obj);
+	if (it != m_obj_to_v.end())
+	{
+		m_v_refs[it->second]++;
+		return it->second;
+	}
+
+	graph::VertexID v;
+	if (m_free_verts.empty())
+	{
+		v = (graph::VertexID)m_v_to_obj.size();
+		m_v_to_obj.push_back(obj);
+		m_v_refs.push_back(1);
+	}
+	else
+	{
+		v = m_free_verts.back();
+		m_free_verts.pop_back();
+		m_v_to_obj[v] = obj;
+		m_v_refs[v] = 1;
+	}
+
+	m_obj_to_v.emplace(obj, v);
+	return v;
+}
+
+void NetIndex::unref_vertex(graph::VertexID v)
+{
+	assert(m_v_refs[v] > 0);
+	if (--m_v_refs[v] == 0)
+	{
+		m_obj_to_v.erase(m_v_to_obj[v]);
+		m_v_to_obj[v] = nullptr;
+		m_free_verts.push_back(v);
+	}
+}
+
+void NetIndex::set_ends(graph::EdgeID e, Link* link)
+{
+	// Take the new ends first, so that a vertex shared by the old and new ends
+	// doesn't get recycled in between
+	graph::VPair new_ends(graph::INVALID_V, graph::INVALID_V);
+	if (link)
+	{
+		auto src = link->get_src_ep();
+		auto sink = link->get_sink_ep();
+		if (src) new_ends.first = ref_vertex(src->get_obj());
+		if (sink) new_ends.second = ref_vertex(sink->get_obj());
+	}
+
+	graph::VPair& ends = m_ends[e];
+	if (ends.first != graph::INVALID_V) unref_vertex(ends.first);
+	if (ends.second != graph::INVALID_V) unref_vertex(ends.second);
+
+	ends = new_ends;
+	m_graph_valid = false;
+}
+
 //
 // Endpoint
 //
@@ -315,7 +553,7 @@ Endpoint* Endpoint::get_sibling() const
 
 
 Link::Link(Endpoint* src, Endpoint* sink)
-	: m_id(LINK_INVALID)
+	: m_id(LINK_INVALID), m_index(nullptr)
 {
 	set_src_ep(src);
 	set_sink_ep(sink);
@@ -327,9 +565,9 @@ Link::Link()
 }
 
 Link::Link(const Link& o)
-	: m_src(nullptr), m_sink(nullptr), m_id(o.m_id)
+	: m_src(nullptr), m_sink(nullptr), m_id(o.m_id), m_index(nullptr)
 {
-	// zero out src/sink when cloning
+	// zero out src/sink when cloning. The clone isn't in any container's index yet.
 }
 
 Link::~Link()
@@ -403,11 +641,13 @@ Endpoint* Link::get_other_ep(const Endpoint* ep) const
 void Link::set_src_ep(Endpoint* ep)
 {
 	m_src = ep;
+	if (m_index) m_index->update_link(this);
 }
 
 void Link::set_sink_ep(Endpoint* ep)
 {
 	m_sink = ep;
+	if (m_index) m_index->update_link(this);
 }
 
 NetType Link::get_type() const
@@ -424,11 +664,197 @@ Link* Link::clone() const
 // LinkRelations
 //
 
+struct LinkRelations::Closure
+{
+	static const unsigned NONE = std::numeric_limits<unsigned>::max();
+
+	// Related links, sorted by LinkID so each network type is a contiguous range,
+	// and the reverse mapping, indexed by [type][link index]
+	std::vector<LinkID> links;
+	std::vector<std::vector<unsigned>> dense;
+	std::vector<std::pair<unsigned, unsigned>> type_range;
+
+	// Row i of each is a bitset over 'links' of the descendants/ancestors of links[i]
+	unsigned n_words;
+	std::vector<uint64_t> desc;
+	std::vector<uint64_t> anc;
+
+	unsigned to_dense(LinkID id) const
+	{
+		auto type = id.get_type();
+		auto idx = id.get_index();
+		if (type >= dense.size() || idx >= dense[type].size())
+			return NONE;
+		return dense[type][idx];
+	}
+
+	uint64_t* row(std::vector<uint64_t>& bits, unsigned i)
+	{
+		return &bits[(size_t)i * n_words];
+	}
+
+	const uint64_t* row(const std::vector<uint64_t>& bits, unsigned i) const
+	{
+		return &bits[(size_t)i * n_words];
+	}
+
+	static bool test(const uint64_t* r, unsigned j)
+	{
+		return (r[j / 64] >> (j % 64)) & 1;
+	}
+
+	static void set(uint64_t* r, unsigned j)
+	{
+		r[j / 64] |= (uint64_t)1 << (j % 64);
+	}
+
+	// Append the members of row i that are of the given type
+	void collect(const std::vector<uint64_t>& bits, unsigned i, NetType type,
+		std::vector<LinkID>& out) const
+	{
+		if (type >= type_range.size())
+			return;
+
+		unsigned begin = type_range[type].first;
+		unsigned end = type_range[type].second;
+		auto r = row(bits, i);
+
+		for (unsigned wi = begin / 64; wi * 64 < end; wi++)
+		{
+			uint64_t w = r[wi];
+			for (unsigned j = wi * 64; w; w >>= 1, j++)
+			{
+				if ((w & 1) && j >= begin && j < end)
+					out.push_back(links[j]);
+			}
+		}
+	}
+};
+
+const unsigned LinkRelations::Closure::NONE;
+
+void LinkRelations::freeze()
+{
+	using namespace graph;
+
+	if (m_closure)
+		return;
+
+	auto c = std::make_shared<Closure>();
+
+	// Number the links densely
+	for (auto v : m_graph.iter_verts)
+		c->links.push_back((LinkID)v);
+
+	std::sort(c->links.begin(), c->links.end());
+	unsigned n = (unsigned)c->links.size();
+
+	for (unsigned i = 0; i < n; i++)
+	{
+		auto type = c->links[i].get_type();
+		auto idx = c->links[i].get_index();
+
+		if (type >= c->dense.size())
+		{
+			c->dense.resize(type + 1);
+			c->type_range.resize(type + 1, { i, i });
+		}
+
+		auto& tbl = c->dense[type];
+		if (idx >= tbl.size())
+			tbl.resize(idx + 1, Closure::NONE);
+		tbl[idx] = i;
+
+		if (c->type_range[type].second == c->type_range[type].first)
+			c->type_range[type].first = i;
+		c->type_range[type].second = i + 1;
+	}
+
+	// Children of each link, and a topological order (parents first)
+	std::vector<std::vector<unsigned>> kids(n);
+	std::vector<unsigned> n_parents(n, 0);
+	for (unsigned i = 0; i < n; i++)
+	{
+		for (auto v : m_graph.dir_neigh((VertexID)c->links[i]))
+		{
+			unsigned k = c->to_dense((LinkID)v);
+			kids[i].push_back(k);
+			n_parents[k]++;
+		}
+	}
+
+	std::vector<unsigned> order;
+	order.reserve(n);
+	for (unsigned i = 0; i < n; i++)
+	{
+		if (n_parents[i] == 0)
+			order.push_back(i);
+	}
+
+	for (unsigned oi = 0; oi < order.size(); oi++)
+	{
+		for (auto k : kids[order[oi]])
+		{
+			if (--n_parents[k] == 0)
+				order.push_back(k);
+		}
+	}
+
+	// Relations are containment, which can't be cyclic. Stay unfrozen if they somehow are.
+	assert(order.size() == n);
+	if (order.size() != n)
+		return;
+
+	// Descendants accumulate children-first, ancestors parents-first
+	c->n_words = (n + 63) / 64;
+	c->desc.assign((size_t)n * c->n_words, 0);
+	c->anc.assign((size_t)n * c->n_words, 0);
+
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		auto r = c->row(c->desc, *it);
+		for (auto k : kids[*it])
+		{
+			auto rk = c->row(c->desc, k);
+			for (unsigned w = 0; w < c->n_words; w++)
+				r[w] |= rk[w];
+			Closure::set(r, k);
+		}
+	}
+
+	for (auto i : order)
+	{
+		auto r = c->row(c->anc, i);
+		for (auto k : kids[i])
+		{
+			auto rk = c->row(c->anc, k);
+			for (unsigned w = 0; w < c->n_words; w++)
+				rk[w] |= r[w];
+			Closure::set(rk, i);
+		}
+	}
+
+	m_closure = c;
+}
+
+std::vector<LinkID> LinkRelations::get_porc_frozen(LinkID link, NetType net, bool parents) const
+{
+	std::vector<LinkID> result;
+
+	unsigned i = m_closure->to_dense(link);
+	if (i != Closure::NONE)
+		m_closure->collect(parents ? m_closure->anc : m_closure->desc, i, net, result);
+
+	return result;
+}
+
 void LinkRelations::add(LinkID parent, LinkID child)
 {
 	using namespace graph;
 
 	// Get or create vertices for links
+	m_closure.reset();
+
 	VertexID par_v = (VertexID)parent;
 	VertexID child_v = (VertexID)child;
 
@@ -451,6 +877,8 @@ void LinkRelations::remove(LinkID parent, LinkID child)
 	if (!m_graph.hasv(par_v) || !m_graph.hasv(child_v))
 		return;
 
+	m_closure.reset();
+
 	EdgeID e = m_graph.dir_edge(par_v, child_v);
 	if (e != INVALID_E)
 		m_graph.dele(e);
@@ -460,6 +888,14 @@ bool LinkRelations::is_contained_in(LinkID parent, LinkID child) const
 {
 	using namespace graph;
 
+	if (m_closure)
+	{
+		unsigned par_i = m_closure->to_dense(parent);
+		unsigned child_i = m_closure->to_dense(child);
+		return par_i != Closure::NONE && child_i != Closure::NONE &&
+			Closure::test(m_closure->row(m_closure->desc, par_i), child_i);
+	}
+
 	VertexID par_v = (VertexID)parent;
 	VertexID child_v = (VertexID)child;
 
@@ -496,6 +932,7 @@ void LinkRelations::unregister_link(LinkID link)
 
 	VertexID vid = (VertexID)link;
 	m_graph.delv(vid);
+	m_closure.reset();
 }
 
 std::vector<LinkID> LinkRelations::get_immediate_parents(LinkID link) const
@@ -555,6 +992,9 @@ std::vector<LinkID> LinkRelations::get_porc_internal(LinkID link, NetType net,
 {
 	using namespace graph;
 
+	if (m_closure)
+		return get_porc_frozen(link, net, grafunc == &Graph::dir_neigh_r);
+
 	std::vector<LinkID> result;
 
 	VertexID firstv = (VertexID)link;
@@ -590,6 +1030,8 @@ std::vector<LinkID> LinkRelations::get_porc_internal(LinkID link, NetType net,
 
 void LinkRelations::prune(Node* dest)
 {
+	m_closure.reset();
+
 	// Remove all vertices not present in dest
 	std::vector<graph::VertexID> to_remove;
 	for (auto v : m_graph.iter_verts)
@@ -614,6 +1056,48 @@ void LinkRelations::reintegrate(LinkRelations& src)
 {
 	// Perform a union of the graphs
 	m_graph.union_with(src.m_graph);
+	m_closure.reset();
+}
+
+void LinkRelations::rebase(const LinkIDMark& old_base, const LinkIDMark& new_base)
+{
+	using namespace graph;
+
+	// Follow the same renumbering that LinksContainer::rebase does for the links themselves,
+	// and do the same for relation edges
+	auto vfunc = [&](VertexID v)
+	{
+		LinkID id(v);
+		auto type = id.get_type();
+		auto old_idx = old_base.get_link_id(type);
+
+		if (id.get_index() >= old_idx)
+			id.set_index(id.get_index() + new_base.get_link_id(type) - old_idx);
+
+		return (VertexID)id;
+	};
+
+	auto efunc = [&](EdgeID e)
+	{
+		return e >= old_base.rel_id ? e + new_base.rel_id - old_base.rel_id : e;
+	};
+
+	m_graph.remap(vfunc, efunc);
+	m_closure.reset();
+}
+
+graph::EdgeID LinkRelations::get_next_id() const
+{
+	return m_graph.get_next_eid();
+}
+
+//
+// LinkIDMark
+//
+
+uint32_t LinkIDMark::get_link_id(NetType type) const
+{
+	return type < link_ids.size() ? link_ids[type] : 0;
 }
 
 
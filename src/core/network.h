@@ -16,6 +16,7 @@ namespace impl
 	class Link;
 	class Endpoint;
 	class EndpointPair;
+	class NetIndex;
 
 	class NetworkDef
 	{
@@ -84,19 +85,29 @@ namespace impl
 	};
 
 	// An integer ID for a link.
-	// Encodes its type and index of that type
+	// Encodes its type and index of that type: the type in the top TYPE_BITS,
+	// and the index in the remaining INDEX_BITS. It stays 32 bits wide so that it
+	// can double as a graph VertexID (see LinkRelations).
 	struct LinkID
 	{
 	private:
 		uint32_t _id;
 
 	public:
-		constexpr LinkID(NetType type, uint16_t index)
-			: _id((type << 16U) | index) {}
+		static constexpr unsigned TYPE_BITS = 8;
+		static constexpr unsigned INDEX_BITS = 32 - TYPE_BITS;
+		static constexpr uint32_t INDEX_MASK = (1U << INDEX_BITS) - 1;
+		static constexpr uint32_t MAX_INDEX = INDEX_MASK;
+		// All-ones type field stands for NET_INVALID
+		static constexpr uint32_t TYPE_INVALID = (1U << TYPE_BITS) - 1;
+
+		constexpr LinkID(NetType type, uint32_t index)
+			: _id(((type == NET_INVALID ? TYPE_INVALID : (uint32_t)type) << INDEX_BITS) |
+				(index & INDEX_MASK)) {}
 		LinkID() = default;
 
-		void set_index(uint16_t idx);
-		uint16_t get_index() const;
+		void set_index(uint32_t idx);
+		uint32_t get_index() const;
 
 		void set_type(NetType type);
 		NetType get_type() const;
@@ -109,7 +120,7 @@ namespace impl
 		explicit operator uint32_t() const;
 	};
 
-	constexpr LinkID LINK_INVALID = { NET_INVALID, std::numeric_limits<uint16_t>::max() };
+	constexpr LinkID LINK_INVALID = { NET_INVALID, LinkID::MAX_INDEX };
 
 	// A connection for a particular network type.
 	class Link : virtual public genie::Link
@@ -138,6 +149,8 @@ namespace impl
 		void set_src_ep(Endpoint*);
 		void set_sink_ep(Endpoint*);
 
+		PROP_GET_SET(net_index, NetIndex*, m_index);
+
 		NetType get_type() const;
 
 		virtual Link* clone() const;
@@ -147,6 +160,50 @@ namespace impl
 		LinkID m_id;
 		Endpoint* m_src;
 		Endpoint* m_sink;
+		NetIndex* m_index;
+	};
+
+	// Incrementally-maintained adjacency index over the links of one LinksContainer.
+	// Each endpoint object gets a vertex, and each link is an edge numbered by its
+	// LinkID index. Links notify the index when their endpoints change, so the graph
+	// never has to be rebuilt from scratch by walking and hashing all the links.
+	// Vertices whose objects lose all their links are recycled, and removed links leave
+	// gaps, so get_object() and get_link() can return nullptr.
+	class NetIndex
+	{
+	public:
+		void add_link(Link*);
+		void remove_link(Link*);
+		void update_link(Link*);
+		void rebuild(const std::vector<Link*>& links);
+
+		unsigned n_verts() const { return (unsigned)m_v_to_obj.size(); }
+		unsigned n_edges() const { return (unsigned)m_e_to_link.size(); }
+		graph::VertexID get_vertex(HierObject*) const;
+		HierObject* get_object(graph::VertexID v) const { return m_v_to_obj[v]; }
+		Link* get_link(graph::EdgeID e) const { return m_e_to_link[e]; }
+
+		PROP_GET(obj_to_v, const graph::Attr2V<HierObject*>&, m_obj_to_v);
+		PROP_GET(v_to_obj, const graph::VArray<HierObject*>&, m_v_to_obj);
+		PROP_GET(e_to_link, const graph::EArray<Link*>&, m_e_to_link);
+		PROP_GET(edge_ends, const std::vector<graph::VPair>&, m_ends);
+
+		// Frozen snapshot of the current adjacency, rebuilt only after changes
+		const graph::CSRGraph& get_graph();
+
+	protected:
+		graph::VertexID ref_vertex(HierObject*);
+		void unref_vertex(graph::VertexID);
+		void set_ends(graph::EdgeID, Link*);
+
+		graph::Attr2V<HierObject*> m_obj_to_v;
+		graph::VArray<HierObject*> m_v_to_obj;
+		graph::VArray<unsigned> m_v_refs;
+		graph::VList m_free_verts;
+		graph::EArray<Link*> m_e_to_link;
+		std::vector<graph::VPair> m_ends;
+		graph::CSRGraph m_graph;
+		bool m_graph_valid = false;
 	};
 
 	class LinksContainer
@@ -155,14 +212,20 @@ namespace impl
 		LinksContainer();
 
 		PROP_GET_SET(type, NetType, m_type);
+		PROP_GET(next_id, uint32_t, m_next_id);
 		LinkID insert_new(Link*);
 		void insert_existing(Link*);
 		std::vector<Link*> move_new_from(LinksContainer&);
 		void prepare_for_copy(const LinksContainer&);
+		void rebase(uint32_t old_base, uint32_t new_base);
+		uint32_t pin_ids();
 		Link* get(LinkID);
 		Link* remove(LinkID);
 		std::vector<Link*> get_all() const;
 
+		void enable_index();
+		NetIndex* get_index() const { return m_index.get(); }
+
 		template<class T=Link>
 		std::vector<T*> get_all_casted() const
 		{
@@ -175,11 +238,18 @@ namespace impl
 		using ThuncFunc = std::function<void*(Link*)>;
 
 		void get_all_internal(void* out, const ThuncFunc&) const;
-		void ensure_size_for_index(uint16_t idx);
+		void ensure_size_for_index(uint32_t idx);
 
 		NetType m_type;
-		uint16_t m_next_id;
+		uint32_t m_next_id;
 		std::vector<Link*> m_links;
+
+		// Indices of removed links, available for reuse by insert_new.
+		// Only indices at or above m_recycle_floor are ever reused: anything below
+		// may still be known to the Node this was copied from, or to an outstanding LinkIDMark.
+		std::vector<uint32_t> m_free_ids;
+		uint32_t m_recycle_floor;
+		std::unique_ptr<NetIndex> m_index;
 	};
 
 	class EndpointPair
@@ -193,11 +263,23 @@ namespace impl
 		EndpointPair(const EndpointPair&) = default;
 	};
 
+	// The next free link ID indices (per network type) and link relation ID of a Node,
+	// captured at some point in time. Anything at or above these was created afterwards.
+	struct LinkIDMark
+	{
+		std::vector<uint32_t> link_ids;
+		graph::EdgeID rel_id;
+
+		uint32_t get_link_id(NetType type) const;
+	};
+
 	class LinkRelations
 	{
 	public:
 		void prune(Node* dest);
 		void reintegrate(LinkRelations& src);
+		void rebase(const LinkIDMark& old_base, const LinkIDMark& new_base);
+		graph::EdgeID get_next_id() const;
 
 		void add(LinkID parent, LinkID child);
 		void remove(LinkID parent, LinkID child);
@@ -209,6 +291,13 @@ namespace impl
 		std::vector<LinkID> get_parents(LinkID link, NetType type) const;
 		std::vector<LinkID> get_children(LinkID link, NetType type) const;
 
+		// Precompute the transitive closure of the relations, so that is_contained_in is O(1)
+		// and get_parents/get_children are O(answer) until the next change, which discards it.
+		// Worth doing before a pass that queries a lot without adding or removing relations.
+		// With it, get_parents/get_children return each link once, ordered by LinkID.
+		void freeze();
+		bool is_frozen() const { return (bool)m_closure; }
+
 		template<class T = Link>
 		std::vector<T*> get_parents(Link* link, NetType net, Node* sys) const
 		{
@@ -240,7 +329,13 @@ namespace impl
 		std::vector<LinkID> get_porc_internal(LinkID link, NetType net,
 			graph::VList(graph::Graph::*)(graph::VertexID) const) const;
 
+		struct Closure;
+		std::vector<LinkID> get_porc_frozen(LinkID link, NetType net, bool parents) const;
+
 		graph::Graph m_graph;
+
+		// Built by freeze(). Immutable, so copies of this object can share it.
+		std::shared_ptr<const Closure> m_closure;
 	};
 }
 }
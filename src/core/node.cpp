@@ -300,6 +300,17 @@ Link * Node::remove_link(LinkID id)
 	return cont.remove(id);
 }
 
+void Node::enable_net_index(NetType type)
+{
+	assert(type != NET_INVALID);
+	get_links_cont(type).enable_index();
+}
+
+NetIndex* Node::get_net_index(NetType type)
+{
+	return get_links_cont(type).get_index();
+}
+
 
 Link * Node::connect(HierObject * src, HierObject * sink, NetType net)
 {
@@ -511,6 +522,9 @@ void Node::copy_links_from(const Node & src, const Links & links)
 	{
 		auto& cont = get_links_cont(other_cont.get_type());
 		cont.prepare_for_copy(other_cont);
+
+		if (other_cont.get_index())
+			cont.enable_index();
 	}
 
 	// Copy the links
@@ -552,6 +566,38 @@ void Node::copy_links_from(const Node & src, const Links & links)
 	m_link_rel.prune(this);
 }
 
+LinkIDMark Node::get_link_id_mark()
+{
+	LinkIDMark result;
+
+	// Links created after this point must get indices at or above the mark,
+	// so removed indices below it can't be recycled anymore
+	for (auto& cont : m_links)
+	{
+		result.link_ids.push_back(cont.pin_ids());
+	}
+
+	result.rel_id = m_link_rel.get_next_id();
+
+	return result;
+}
+
+void Node::rebase_new_links(const LinkIDMark& old_base, const LinkIDMark& new_base)
+{
+	// This Node was copied from another one when that one was at old_base.
+	// The other Node has since gained more links and is now at new_base.
+	// Renumber all links (and link relations) created here since the copy so that they
+	// don't collide with the other Node's newer links upon reintegration, and get
+	// the same IDs they would have had if the copy was made at new_base.
+	for (auto& cont : m_links)
+	{
+		auto type = cont.get_type();
+		cont.rebase(old_base.get_link_id(type), new_base.get_link_id(type));
+	}
+
+	m_link_rel.rebase(old_base, new_base);
+}
+
 void Node::reintegrate_partial(Node * src, const std::vector<HierObject*>& objs, 
 	const std::vector<Link*>& links)
 {
@@ -595,8 +641,10 @@ void Node::reintegrate_partial(Node * src, const std::vector<HierObject*>& objs,
 		link->disconnect_src();
 		link->disconnect_sink();
 
+		// Keep the link's ID. It's either one we lost to src, or one that src
+		// created and that was rebased not to collide with ours.
 		src->remove_link(link->get_id());
-		add_link(link->get_type(), link);
+		get_links_cont(link->get_type()).insert_existing(link);
 	}
 
 	// 
@@ -80,8 +80,15 @@ namespace impl
 		void disconnect(Link*);
 		Link* splice(Link* orig, HierObject* new_sink, HierObject* new_src);
 		bool is_link_internal(Link*) const;
+
+		// Optional adjacency index for one network type, kept up to date as links
+		// change and inherited by copies of this Node. Null if not enabled.
+		void enable_net_index(NetType);
+		NetIndex* get_net_index(NetType);
 		
 		void copy_links_from(const Node& src, const Links& links);
+		LinkIDMark get_link_id_mark();
+		void rebase_new_links(const LinkIDMark& old_base, const LinkIDMark& new_base);
 
 		PROP_GETR(link_relations, LinkRelations&, m_link_rel);
 
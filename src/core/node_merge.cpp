@@ -282,19 +282,36 @@ AreaMetrics NodeMerge::annotate_area_nonex()
 	bool radix2_driving_reg =
 		m_n_inputs == 2 && node_width >= 7 && does_feed_reg();
 
-	if (node_width == 0)
+	if (radix2_driving_reg)
 	{
-		col_vals[DB_COLS::WIDTH] = 0;
+		// for now: approximate with width=1 (a very small 2-to-1 mux)
+		col_vals[DB_COLS::WIDTH] = 1;
 		auto row = s_prim_db->get_row(col_vals);
 		assert(row);
 		auto metrics = s_prim_db->get_area_metrics(row);
 		assert(metrics);
 		result = *metrics;
 	}
-	else if (radix2_driving_reg)
+	else
 	{
-		// for now: approximate with width=1 (a very small 2-to-1 mux)
-		col_vals[DB_COLS::WIDTH] = 1;
+		result = estimate_area(m_n_inputs, node_width, bp, eop);
+	}
+
+	return result;
+}
+
+AreaMetrics NodeMerge::estimate_area(unsigned n_inputs, unsigned node_width, bool bp, bool eop)
+{
+	AreaMetrics result;
+	unsigned col_vals[DB_COLS::size()];
+
+	col_vals[DB_COLS::BP] = bp ? 1 : 0;
+	col_vals[DB_COLS::EOP] = eop ? 1 : 0;
+	col_vals[DB_COLS::NI] = n_inputs;
+
+	if (node_width == 0)
+	{
+		col_vals[DB_COLS::WIDTH] = 0;
 		auto row = s_prim_db->get_row(col_vals);
 		assert(row);
 		auto metrics = s_prim_db->get_area_metrics(row);
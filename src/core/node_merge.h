@@ -13,6 +13,7 @@ namespace impl
     {
     public:
         static void init();
+		static AreaMetrics estimate_area(unsigned n_inputs, unsigned width, bool bp, bool eop);
         
         // Create a new one
 		NodeMerge();
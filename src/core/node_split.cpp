@@ -195,10 +195,15 @@ AreaMetrics NodeSplit::annotate_area()
 	// Get node config
 	bool bp = get_input()->get_bp_status().status == RSBackpressure::ENABLED;
 
+	return estimate_area(m_n_outputs, bp, m_is_unicast);
+}
+
+AreaMetrics NodeSplit::estimate_area(unsigned n_outputs, bool bp, bool unicast)
+{
 	unsigned col_vals[DB_COLS::size()];
-	col_vals[DB_COLS::N] = m_n_outputs; assert(m_n_outputs <= 32);
+	col_vals[DB_COLS::N] = n_outputs; assert(n_outputs <= 32);
 	col_vals[DB_COLS::BP] = bp ? 1 : 0;
-	col_vals[DB_COLS::NO_MULTICAST] = m_is_unicast ? 1 : 0;
+	col_vals[DB_COLS::NO_MULTICAST] = unicast ? 1 : 0;
 
 	auto row = s_prim_db->get_row(col_vals);
 	assert(row);
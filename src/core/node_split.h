@@ -17,6 +17,7 @@ namespace impl
     {
     public:
         static void init();
+		static AreaMetrics estimate_area(unsigned n_outputs, bool bp, bool unicast);
         
         // Create a new one
 		NodeSplit();
@@ -174,34 +174,24 @@ void NodeSystem::make_exclusive(const std::vector<std::vector<genie::LinkRS*>>&
 {
 	auto& excl = get_spec().excl_info;
 
-	// Iterate over all pairs of sets
-	for (auto it_s1 = sets.begin(); it_s1 != sets.end(); ++it_s1)
+	// All members of each set are mutually exclusive with all members of the
+	// other sets. Record that as one group, without expanding it into pairs.
+	ExclusivityInfo::Group group;
+
+	for (auto& set : sets)
 	{
-		auto& set1 = *it_s1;
+		group.emplace_back();
 
-		for (auto it_s2 = it_s1 + 1; it_s2 != sets.end(); ++it_s2)
+		for (auto link : set)
 		{
-			auto& set2 = *it_s2;
-
-			// For each pair of sets, mutually-exclusivify all members of set1
-			// with all members of set2
-
-			for (auto link1 : set1)
-			{
-				auto impl1 = dynamic_cast<LinkRSLogical*>(link1);
-				assert(impl1);
-
-				for (auto link2 : set2)
-				{
-					auto impl2 = dynamic_cast<LinkRSLogical*>(link2);
-					assert(impl2);
+			auto impl = dynamic_cast<LinkRSLogical*>(link);
+			assert(impl);
 
-					excl.add(impl1->get_id(), impl2->get_id());
-				} // end all links in set2
-			} // end all links in set1
+			group.back().push_back(impl->get_id());
+		}
+	}
 
-		} // end all set2
-	} // end all set1
+	excl.add_group(group);
 }
 
 void NodeSystem::add_sync_constraint(const genie::SyncConstraint & constraint)
@@ -336,36 +326,50 @@ NodeSystem::NodeSystem(const NodeSystem& o, bool copy_contents)
 // Exclusivity Info
 //
 
-void ExclusivityInfo::add(LinkID link1, LinkID link2)
+void ExclusivityInfo::add_group(const Group& group)
 {
-	if (link1 == link2)
+	// Need at least two parts for anything to be exclusive
+	if (group.size() < 2)
 		return;
 
-	// Make canonical ordering
-	if (link2 < link1)
-		std::swap(link1, link2);
+	unsigned group_idx = m_groups.size();
+	m_groups.push_back(group);
 
-	m_sets[link1].insert(link2);
-}
+	for (unsigned part = 0; part < group.size(); part++)
+	{
+		for (auto link : group[part])
+		{
+			auto& mships = m_membership[link];
 
-ExclusivityInfo::Set & ExclusivityInfo::get_set(LinkID id)
-{
-	return m_sets[id];
+			// A link listed twice in the same part only needs one entry
+			if (mships.empty() || mships.back().group != group_idx ||
+				mships.back().part != part)
+			{
+				mships.push_back({ group_idx, part });
+			}
+		}
+	}
 }
 
-bool ExclusivityInfo::are_exclusive(LinkID link1, LinkID link2)
+bool ExclusivityInfo::are_exclusive(LinkID link1, LinkID link2) const
 {
 	if (link1 == link2)
 		return true;
 
-	if (link2 < link1)
-		std::swap(link1, link2);
+	auto it1 = m_membership.find(link1);
+	auto it2 = m_membership.find(link2);
+	if (it1 == m_membership.end() || it2 == m_membership.end())
+		return false;
 
-	auto it = m_sets.find(link1);
-	return (it != m_sets.end());
-}
+	// Exclusive if they're in different parts of a common group
+	for (auto& m1 : it1->second)
+	{
+		for (auto& m2 : it2->second)
+		{
+			if (m1.group == m2.group && m1.part != m2.part)
+				return true;
+		}
+	}
 
-std::vector<LinkID> genie::impl::ExclusivityInfo::get_links_with_exclusivity()
-{
-	return util::keys<std::vector<LinkID>>(m_sets);
+	return false;
 }
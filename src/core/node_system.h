@@ -9,18 +9,30 @@ namespace genie
 namespace impl
 {
 	// TODO: move spec types to separate file?
+	// Temporal exclusivity between RS logical links, kept in the groups it was specified in
+	// rather than expanded into pairs. Each group is a list of parts, and links in different
+	// parts of the same group are mutually exclusive.
 	class ExclusivityInfo
 	{
 	public:
-		using Set = std::unordered_set<LinkID>;
+		using Part = std::vector<LinkID>;
+		using Group = std::vector<Part>;
 
-		void add(LinkID, LinkID);
-		Set& get_set(LinkID);
-		bool are_exclusive(LinkID, LinkID);
-		std::vector<LinkID> get_links_with_exclusivity();
+		void add_group(const Group&);
+		bool are_exclusive(LinkID, LinkID) const;
+
+		PROP_GET(groups, const std::vector<Group>&, m_groups);
 		
 	protected:
-		std::unordered_map<LinkID,Set> m_sets;
+		// Which part of which group a link is in. Usually there's just one.
+		struct Membership
+		{
+			unsigned group;
+			unsigned part;
+		};
+
+		std::vector<Group> m_groups;
+		std::unordered_map<LinkID, std::vector<Membership>> m_membership;
 	};
 
 	struct LatencyQuery
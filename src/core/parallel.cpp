@@ -0,0 +1,118 @@
+#include "pch.h"
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include "parallel.h"
+#include "genie_priv.h"
+
+using namespace genie::impl;
+
+namespace
+{
+	// Number of extra threads currently running, across all for_each_index calls.
+	// Nested calls share the --jobs budget rather than multiplying it.
+	std::atomic<unsigned> s_busy_threads(0);
+
+	unsigned reserve_threads(unsigned want)
+	{
+		unsigned limit = parallel::get_n_jobs() - 1;
+		unsigned cur = s_busy_threads.load();
+		unsigned got;
+
+		do
+		{
+			got = cur >= limit ? 0 : std::min(want, limit - cur);
+		} while (got && !s_busy_threads.compare_exchange_weak(cur, cur + got));
+
+		return got;
+	}
+
+	// Gives reserved threads back to the budget on the way out, however that happens
+	struct ThreadReservation
+	{
+		unsigned count;
+
+		ThreadReservation(unsigned want) : count(reserve_threads(want)) {}
+		~ThreadReservation() { s_busy_threads -= count; }
+	};
+}
+
+unsigned parallel::get_n_jobs()
+{
+	unsigned result = genie::impl::get_flow_options().jobs;
+
+	if (result == 0)
+		result = std::max(1U, std::thread::hardware_concurrency());
+
+	return result;
+}
+
+void parallel::for_each_index(unsigned n, unsigned n_jobs,
+	const std::function<void(unsigned)>& func)
+{
+	// The calling thread is one of the workers. See how many others we can get.
+	n_jobs = std::min(n_jobs, n);
+	ThreadReservation reservation(n_jobs > 1 ? n_jobs - 1 : 0);
+	unsigned n_extra = reservation.count;
+
+	// Nothing to gain from threads: just run everything here
+	if (n_extra == 0)
+	{
+		for (unsigned i = 0; i < n; i++)
+			func(i);
+		return;
+	}
+
+	// Workers grab the next unclaimed index until none are left.
+	// Exceptions are captured per-index and rethrown once everyone is done.
+	std::atomic<unsigned> next_idx(0);
+	std::vector<std::exception_ptr> errors(n);
+
+	// Workers log wherever the calling thread does
+	auto log_buf = genie::log::get_thread_buffer();
+
+	auto worker = [&]()
+	{
+		genie::log::set_thread_buffer(log_buf);
+
+		for (unsigned i = next_idx++; i < n; i = next_idx++)
+		{
+			try
+			{
+				func(i);
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+
+	// If a thread can't be started, carry on with the ones that were, and give the
+	// slots reserved for the rest back to other callers right away
+	std::vector<std::thread> threads;
+	threads.reserve(n_extra);
+	try
+	{
+		for (unsigned i = 0; i < n_extra; i++)
+			threads.emplace_back(worker);
+	}
+	catch (const std::system_error&)
+	{
+		unsigned n_unused = n_extra - (unsigned)threads.size();
+		s_busy_threads -= n_unused;
+		reservation.count -= n_unused;
+	}
+
+	worker();
+
+	for (auto& t : threads)
+		t.join();
+
+	for (auto& err : errors)
+	{
+		if (err)
+			std::rethrow_exception(err);
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <functional>
+
+namespace genie
+{
+namespace impl
+{
+namespace parallel
+{
+	// Number of worker threads requested with --jobs.
+	// A value of 0 means 'one per hardware thread'.
+	unsigned get_n_jobs();
+
+	// Calls func(i) for every i in [0, n), using up to n_jobs threads.
+	// Threads are drawn from a process-wide pool of get_n_jobs(), so nested calls
+	// may get fewer (or run entirely on the calling thread).
+	// Returns once all calls have finished. If any call throws, the exception
+	// thrown for the lowest index is rethrown in the calling thread.
+	void for_each_index(unsigned n, unsigned n_jobs,
+		const std::function<void(unsigned)>& func);
+}
+}
+}
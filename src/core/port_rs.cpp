@@ -212,10 +212,21 @@ Port * PortRS::export_port(const std::string & name, NodeSystem* context)
 
 void PortRS::reintegrate(HierObject* obj)
 {
-	// Copy protocol info from other port when reintegrating snapshots
+	// Copy protocol info from other port when reintegrating snapshots.
+	// Snapshots also carry copies of ports that belong to other domains, whose
+	// protocol info may be stale. Only take it from ports with logical links in
+	// the snapshot.
 	auto that = static_cast<PortRS*>(obj);
 
-	this->m_proto = that->m_proto;
+	for (auto dir : { Port::Dir::IN, Port::Dir::OUT })
+	{
+		auto ep = that->get_endpoint(NET_RS_LOGICAL, dir);
+		if (ep && ep->is_connected())
+		{
+			this->m_proto = that->m_proto;
+			break;
+		}
+	}
 }
 
 HierObject * PortRS::instantiate() const
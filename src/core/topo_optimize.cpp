@@ -6,6 +6,10 @@
 #include "port.h"
 #include "net_rs.h"
 #include "net_topo.h"
+#include "port_rs.h"
+#include "genie_priv.h"
+#include <random>
+#include <cmath>
 
 using namespace genie;
 using namespace impl;
@@ -20,9 +24,21 @@ namespace
 	// Holds the contention between all pairs of transmissions:
 	// - do they contend?
 	// - for each transmission, the total contention
+	//
+	// Changes made after checkpoint() are journaled, and can be undone with rollback().
+	// This lets merge candidates be evaluated on top of the base contention in place,
+	// at a cost proportional to the contention they add rather than the map size.
+	// Checkpoints nest: commit() ends the innermost one but keeps its changes,
+	// which are then undone by the rollback of an enclosing checkpoint.
 	class ContentionMap
 	{
 	public:
+		struct Mark
+		{
+			size_t contend;
+			size_t totals;
+		};
+
 		void init(unsigned count)
 		{
 			m_count = count;
@@ -31,15 +47,68 @@ namespace
 
 			for (auto&& i : m_contend) i = false; // weird stuff for std::vector<bool>
 			for (auto& i : m_totals) i = 0;
+
+			m_journal_depth = 0;
+			m_undo_contend.clear();
+			m_undo_totals.clear();
 		}
 
 		void add(TransmissionID t1, TransmissionID t2, float val1, float val2)
 		{
-			m_contend[idx(t1, t2)] = true;
+			auto i = idx(t1, t2);
+
+			if (m_journal_depth > 0)
+			{
+				if (!m_contend[i])
+					m_undo_contend.push_back(i);
+
+				m_undo_totals.emplace_back(t1, m_totals[t1]);
+				m_undo_totals.emplace_back(t2, m_totals[t2]);
+			}
+
+			m_contend[i] = true;
 			m_totals[t1] += val1;
 			m_totals[t2] += val2;
 		}
 
+		Mark checkpoint()
+		{
+			m_journal_depth++;
+			return { m_undo_contend.size(), m_undo_totals.size() };
+		}
+
+		void commit(const Mark&)
+		{
+			assert(m_journal_depth > 0);
+			m_journal_depth--;
+
+			// Nothing can roll back past the outermost checkpoint
+			if (m_journal_depth == 0)
+			{
+				m_undo_contend.clear();
+				m_undo_totals.clear();
+			}
+		}
+
+		void rollback(const Mark& mark)
+		{
+			assert(m_journal_depth > 0);
+
+			// Restore old totals in reverse order, so the earliest (original) value wins
+			for (size_t i = m_undo_totals.size(); i > mark.totals; i--)
+			{
+				auto& undo = m_undo_totals[i - 1];
+				m_totals[undo.first] = undo.second;
+			}
+
+			for (size_t i = mark.contend; i < m_undo_contend.size(); i++)
+				m_contend[m_undo_contend[i]] = false;
+
+			m_undo_contend.resize(mark.contend);
+			m_undo_totals.resize(mark.totals);
+			m_journal_depth--;
+		}
+
 		bool do_contend(TransmissionID t1, TransmissionID t2)
 		{
 			return m_contend[idx(t1, t2)];
@@ -61,6 +130,35 @@ namespace
 		unsigned m_count;
 		std::vector<bool> m_contend;
 		std::vector<float> m_totals;
+
+		unsigned m_journal_depth = 0;
+		std::vector<unsigned> m_undo_contend;
+		std::vector<std::pair<TransmissionID, float>> m_undo_totals;
+	};
+}
+
+namespace
+{
+	struct TopoWithLogicalLinks
+	{
+		LinkID topo;
+		std::vector<LinkID> logicals;
+	};
+
+	// Topo inputs of a merge node, keyed by an integer ID of their source object
+	// and sorted by that ID. Source IDs are handed out per base system.
+	using SrcID = unsigned;
+	using MergeInputsBySrc = std::vector<std::pair<SrcID, TopoWithLogicalLinks>>;
+
+	// Kinds of moves that derive a candidate from the base topology,
+	// tried in this order
+	enum class MoveType
+	{
+		PAIR,		// combine two merge nodes
+		GROUP,		// combine a group of three or more merge nodes at once
+		PULL_OUT,	// take one input out of a shared merge node
+		RESHARE,	// move one output of a shared merge node's split to another merge node
+		DONE
 	};
 }
 
@@ -75,36 +173,48 @@ struct topo_opt::TopoOptState
 	ContentionMap iter_base_contention;
 
 	std::vector<NodeMerge*> merge_nodes;
+	std::vector<MergeInputsBySrc> merge_inputs;
 	unsigned cur_merge1;
 	unsigned cur_merge2;
+
+	// Iteration state for the other moves
+	MoveType cur_move;
+	unsigned cur_a;
+	unsigned cur_b;
+	unsigned cur_c;
 };
 
 namespace
 {
-	struct TopoWithLogicalLinks
-	{
-		LinkID topo;
-		std::vector<LinkID> logicals;
-	};
-
-	using MergeInputsBySrc = std::map<std::string, TopoWithLogicalLinks>;
-
 	void process_contention_between_links(const std::vector<LinkID>& links1,
 		const std::vector<LinkID>& links2,
 		NodeSystem* sys, FlowStateOuter* fstate, ContentionMap& result)
 	{
-		auto& excl = sys->get_spec().excl_info;
+		// Transmissions of links2, individually and as a set
+		std::vector<TransmissionID> xmis_list2;
+		TransmissionSet xmis_set2;
+		for (auto link2 : links2)
+		{
+			xmis_list2.push_back(fstate->get_transmission_for_link(link2));
+			xmis_set2.add(xmis_list2.back());
+		}
 
 		for (auto link1 : links1)
 		{
 			auto xmis1 = fstate->get_transmission_for_link(link1);
+
+			// Nothing to do if it can't contend with any of them
+			if (fstate->are_transmissions_exclusive(xmis1, xmis_set2))
+				continue;
+
 			auto linkp1 = static_cast<LinkRSLogical*>(sys->get_link(link1));
 			auto src1 = linkp1->get_src();
 			unsigned pkt1 = linkp1->get_packet_size();
 
-			for (auto link2 : links2)
+			for (unsigned i2 = 0; i2 < links2.size(); i2++)
 			{
-				auto xmis2 = fstate->get_transmission_for_link(link2);
+				auto link2 = links2[i2];
+				auto xmis2 = xmis_list2[i2];
 
 				bool same_transmission = xmis1 == xmis2;
 				if (same_transmission)
@@ -209,26 +319,54 @@ namespace
 		process_contention_between_link_groups(loglink_by_input, sys, fstate, result);
 	}
 
-	void populate_merge_inputs(NodeMerge* mg, MergeInputsBySrc& out, LinkRelations& rel)
+	void populate_merge_inputs(NodeMerge* mg, MergeInputsBySrc& out, LinkRelations& rel,
+		std::unordered_map<impl::HierObject*, SrcID>& src_ids)
 	{
 		using impl::Port;
 
 		auto ep = mg->get_endpoint(NET_TOPO, Port::Dir::IN);
 		auto& topos = ep->links();
+
+		out.clear();
+		out.reserve(topos.size());
 		
 		for (auto& topo : topos)
 		{
-			// TODO: mg->get_parent() is a lazy stand-in for the current system
-			auto srcname = topo->get_src()->get_hier_path(mg->get_parent());
-			auto& entry = out[srcname];
-			entry.topo = topo->get_id();
-			entry.logicals = rel.get_parents(entry.topo, NET_RS_LOGICAL);
+			// Intern the source object. IDs are assigned in order of first
+			// appearance, so they're deterministic for a given base system.
+			auto src_id = src_ids.emplace(topo->get_src(), (SrcID)src_ids.size()).first->second;
+
+			out.emplace_back();
+			auto& entry = out.back();
+			entry.first = src_id;
+			entry.second.topo = topo->get_id();
+			entry.second.logicals = rel.get_parents(entry.second.topo, NET_RS_LOGICAL);
 		}
+
+		std::sort(out.begin(), out.end(), 
+			[](const MergeInputsBySrc::value_type& l, const MergeInputsBySrc::value_type& r)
+		{
+			return l.first < r.first;
+		});
+	}
+
+	MergeInputsBySrc::const_iterator find_merge_input(const MergeInputsBySrc& inputs, SrcID src)
+	{
+		auto it = std::lower_bound(inputs.begin(), inputs.end(), src,
+			[](const MergeInputsBySrc::value_type& l, SrcID r)
+		{
+			return l.first < r;
+		});
+
+		if (it != inputs.end() && it->first != src)
+			it = inputs.end();
+
+		return it;
 	}
 
 	bool evaluate_merge_candidate_topoinputs(TopoOptState* tstate,
-		std::vector<LinkID>& topo1,
-		std::vector<LinkID>& topo2,
+		const std::vector<LinkID>& topo1,
+		const std::vector<LinkID>& topo2,
 		ContentionMap& cand_contention)
 	{
 		// Compare logical links from topo1 with those from topo2
@@ -243,9 +381,23 @@ namespace
 		auto& spec = sys->get_spec();
 		auto& xbar_contention = tstate->xbar_contention;
 
+		// Transmissions of topo2, individually and as a set
+		std::vector<TransmissionID> xmis_list2;
+		TransmissionSet xmis_set2;
+		for (auto log_id2 : topo2)
+		{
+			xmis_list2.push_back(fstate->get_transmission_for_link(log_id2));
+			xmis_set2.add(xmis_list2.back());
+		}
+
 		for (auto log_id1 : topo1)
 		{
 			auto xmis1 = fstate->get_transmission_for_link(log_id1);
+
+			// Nothing to do if it can't contend with any of them
+			if (fstate->are_transmissions_exclusive(xmis1, xmis_set2))
+				continue;
+
 			auto linkp1 = static_cast<LinkRSLogical*>(sys->get_link(log_id1));
 			auto src1 = linkp1->get_src();
 			float imp1 = linkp1->get_importance();
@@ -253,9 +405,10 @@ namespace
 
 			float xbar_cont1 = xbar_contention.get_total(xmis1);
 
-			for (auto log_id2 : topo2)
+			for (unsigned i2 = 0; i2 < topo2.size(); i2++)
 			{
-				auto xmis2 = fstate->get_transmission_for_link(log_id2);
+				auto log_id2 = topo2[i2];
+				auto xmis2 = xmis_list2[i2];
 				
 				auto same_xmis = xmis1 == xmis2;
 				if (same_xmis)
@@ -303,41 +456,80 @@ namespace
 		return true;
 	}
 
-	bool evaluate_merge_candidate(TopoOptState* tstate, 
-		NodeMerge* mg1,	MergeInputsBySrc& mg1_inputs,
-		NodeMerge* mg2,	MergeInputsBySrc& mg2_inputs)
+	bool evaluate_merge_inputs(TopoOptState* tstate,
+		const MergeInputsBySrc& mg1_inputs,
+		const MergeInputsBySrc& mg2_inputs,
+		ContentionMap& cand_contention)
 	{
 		// Loop through pairwise: inputs from 1, inputs from 2,
 		// ignoring pairs of inputs that have the same source
-
-		// Make a copy of the contention map from the iterbase
-		ContentionMap cand_contention = tstate->iter_base_contention;
-
 		for (auto& it_mg1 : mg1_inputs)
 		{
-			auto& mg1_srcname = it_mg1.first;
+			auto mg1_src = it_mg1.first;
 			auto& mg1_input = it_mg1.second;
 
 			for (auto& it_mg2 : mg2_inputs)
 			{
-				auto& mg2_srcname = it_mg2.first;
+				auto mg2_src = it_mg2.first;
 				auto& mg2_input = it_mg2.second;
 
 				// Topo inputs that come from the same src can never conflict
-				if (mg1_srcname == mg2_srcname)
+				if (mg1_src == mg2_src)
 					continue;
 
 				if (!evaluate_merge_candidate_topoinputs(tstate, 
 					mg1_input.logicals, 
 					mg2_input.logicals, 
 					cand_contention))
+				{
 					return false;
+				}
 			}
 		}
 
 		return true;
 	}
 
+	bool evaluate_merge_candidate(TopoOptState* tstate, 
+		NodeMerge* mg1,	const MergeInputsBySrc& mg1_inputs,
+		NodeMerge* mg2,	const MergeInputsBySrc& mg2_inputs)
+	{
+		// Evaluate on top of the iterbase's contention map, undoing the changes afterwards
+		ContentionMap& cand_contention = tstate->iter_base_contention;
+		auto mark = cand_contention.checkpoint();
+
+		bool result = evaluate_merge_inputs(tstate, mg1_inputs, mg2_inputs, cand_contention);
+
+		cand_contention.rollback(mark);
+
+		return result;
+	}
+
+	void fixup_merge_nodes(NodeSystem* sys)
+	{
+		using impl::Port;
+
+		// Merge nodes left with only one input get removed, with the incoming link
+		// taking the place of the outgoing one
+		for (auto mg : sys->get_children_by_type<NodeMerge>())
+		{
+			auto ep_in = mg->get_endpoint(NET_TOPO, Port::Dir::IN);
+			if (ep_in->links().size() != 1)
+				continue;
+
+			auto link_in = ep_in->get_link0();
+			auto link_out = mg->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
+			auto ep_downstream = link_out->get_sink_ep();
+
+			sys->disconnect(link_out);
+
+			link_in->disconnect_sink();
+			link_in->reconnect_sink(ep_downstream);
+
+			delete sys->remove_child(mg);
+		}
+	}
+
 	void fixup_split_nodes(NodeSystem* sys)
 	{
 		using impl::Port;
@@ -430,79 +622,114 @@ namespace
 	}
 
 	NodeSystem* create_combined_sys(TopoOptState* tstate,
-		MergeInputsBySrc& mg1_inputs,
-		MergeInputsBySrc& mg2_inputs)
+		const std::vector<unsigned>& group)
 	{
 		using impl::Port;
 
+		// Combines a group of merge nodes, given by their indices in tstate->merge_nodes,
+		// into the first one.
+		assert(group.size() >= 2);
+		auto& mg1_inputs = tstate->merge_inputs[group[0]];
+
 		// First, clone the base system
 		NodeSystem* sys = (NodeSystem*)tstate->iter_base_sys->clone();
 		auto& link_rel = sys->get_link_relations();
 		
 		// Get the merge nodes in the new system
-		auto mg1 = sys->get_child_as<NodeMerge>(tstate->merge_nodes[tstate->cur_merge1]->get_name());
-		auto mg2 = sys->get_child_as<NodeMerge>(tstate->merge_nodes[tstate->cur_merge2]->get_name());
+		std::vector<NodeMerge*> mgs;
+		for (auto idx : group)
+			mgs.push_back(sys->get_child_as<NodeMerge>(tstate->merge_nodes[idx]->get_name()));
 
-		// We're going to delete the second merge node and reroute its links to the first one.
+		auto mg1 = mgs[0];
+
+		// We're going to delete the other merge nodes and reroute their links to the first one.
 		
-		// Disconnect the second merge node's inputs
-		for (auto it : mg2_inputs)
+		// Disconnect the other merge nodes' inputs
+		for (unsigned i = 1; i < group.size(); i++)
 		{
-			auto input = sys->get_link(it.second.topo);
-			input->disconnect_sink();
+			for (auto& it : tstate->merge_inputs[group[i]])
+			{
+				auto input = sys->get_link(it.second.topo);
+				input->disconnect_sink();
+			}
 		}
 
-		// Get and disconnect the second merge node's output
-		auto mg2_output = mg2->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
-		mg2_output->disconnect_src();
+		// Get and disconnect the other merge nodes' outputs, then the first one's
+		std::vector<impl::Link*> mg_outputs(group.size());
+		for (unsigned i = group.size(); i-- > 0; )
+		{
+			mg_outputs[i] = mgs[i]->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
+			mg_outputs[i]->disconnect_src();
+		}
 
-		// Get and disconnect the first merge node's output
-		auto mg1_output = mg1->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
-		mg1_output->disconnect_src();
+		// Remove and destroy the other merge nodes from the system
+		for (unsigned i = 1; i < group.size(); i++)
+		{
+			sys->remove_child(mgs[i]->get_name());
+			delete mgs[i];
+		}
 
-		// Remove and destroy the second merge node from the system
-		sys->remove_child(mg2->get_name());
-		delete mg2;
+		// Sources of inputs moved over to mg1 so far, beyond its original ones
+		std::vector<std::pair<SrcID, LinkID>> moved_inputs;
 
-		// Reconnect mg2 inputs to mg1
-		for (auto mg2_input_it : mg2_inputs)
+		// Reconnect other merge nodes' inputs to mg1
+		for (unsigned i = 1; i < group.size(); i++)
 		{
-			auto& input_src_name = mg2_input_it.first;
-			auto& mg2_input = mg2_input_it.second;
+			for (auto& mg2_input_it : tstate->merge_inputs[group[i]])
+			{
+				auto input_src = mg2_input_it.first;
+				auto& mg2_input = mg2_input_it.second;
 
-			// Two possibilities:
-			// - If mg1 already has an input with the same source, just move over
-			// all the contained logical links, and destroy the topo link
-			// - If not, then reconnect the topo link to mg1
+				// Two possibilities:
+				// - If mg1 already has an input with the same source, just move over
+				// all the contained logical links, and destroy the topo link
+				// - If not, then reconnect the topo link to mg1
 
-			auto existing_mg1_it = mg1_inputs.find(input_src_name);
-			if (existing_mg1_it != mg1_inputs.end())
-			{
-				// Get mg1's existing input and reroute the mg2 logical links to it
-				auto mg1_topo_id = existing_mg1_it->second.topo;
-				for (auto logical : mg2_input.logicals)
+				LinkID mg1_topo_id = LINK_INVALID;
+
+				auto existing_mg1_it = find_merge_input(mg1_inputs, input_src);
+				if (existing_mg1_it != mg1_inputs.end())
 				{
-					link_rel.add(logical, mg1_topo_id);
+					mg1_topo_id = existing_mg1_it->second.topo;
+				}
+				else
+				{
+					for (auto& moved : moved_inputs)
+					{
+						if (moved.first == input_src)
+							mg1_topo_id = moved.second;
+					}
 				}
 
-				// Destroy the mg2 topo link
-				auto mg2_topo_id = mg2_input.topo;
-				sys->disconnect(sys->get_link(mg2_topo_id));
-			}
-			else
-			{
-				// Get the mg2 topo link
-				auto mg2_input_topolink = sys->get_link(mg2_input.topo);
+				if (mg1_topo_id != LINK_INVALID)
+				{
+					// Get mg1's existing input and reroute the mg2 logical links to it
+					for (auto logical : mg2_input.logicals)
+					{
+						link_rel.add(logical, mg1_topo_id);
+					}
 
-				// Just reconnect it to mg1
-				mg2_input_topolink->reconnect_sink(
-					mg1->get_endpoint(NET_TOPO, Port::Dir::IN));
+					// Destroy the mg2 topo link
+					auto mg2_topo_id = mg2_input.topo;
+					sys->disconnect(sys->get_link(mg2_topo_id));
+				}
+				else
+				{
+					// Get the mg2 topo link
+					auto mg2_input_topolink = sys->get_link(mg2_input.topo);
+
+					// Just reconnect it to mg1
+					mg2_input_topolink->reconnect_sink(
+						mg1->get_endpoint(NET_TOPO, Port::Dir::IN));
+
+					moved_inputs.emplace_back(input_src, mg2_input.topo);
+				}
 			}
 		}
 
 		//
 		// Output part: Create a split node, connected to the output of mg1.
-		// The outputs of the split node will be the original mg1 and mg2 outputs.
+		// The outputs of the split node will be the original merge nodes' outputs.
 		// The link from mg1 to the split node needs all logical links routed over it.
 		//
 		
@@ -511,16 +738,16 @@ namespace
 		sp->set_name(sys->make_unique_child_name(util::str_con_cat("sp", mg1->get_name())));
 		sys->add_child(sp);
 
-		// Connect mg1 and mg2 former outputs, as outputs to sp
+		// Connect former merge node outputs, as outputs to sp
 		auto sp_out_ep = sp->get_endpoint(NET_TOPO, Port::Dir::OUT);
-		mg1_output->reconnect_src(sp_out_ep);
-		mg2_output->reconnect_src(sp_out_ep);
+		for (auto output : mg_outputs)
+			output->reconnect_src(sp_out_ep);
 
 		// Create a link from mg1 to sp
 		auto mg_sp_link = sys->connect(mg1, sp, NET_TOPO);
 
 		// Route logical links over it
-		for (auto topo : { mg1_output, mg2_output })
+		for (auto topo : mg_outputs)
 		{
 			auto logicals = link_rel.get_parents(topo->get_id(), NET_RS_LOGICAL);
 			for (auto logical : logicals)
@@ -531,6 +758,478 @@ namespace
 
 		return sys;
 	}
+
+	NodeSplit* get_bus_split(NodeMerge* mg)
+	{
+		// If this merge node is shared by several sinks, returns the split node
+		// that fans its output out to them.
+		auto out = mg->get_endpoint(NET_TOPO, impl::Port::Dir::OUT)->get_link0();
+		return out ? dynamic_cast<NodeSplit*>(out->get_sink()) : nullptr;
+	}
+
+	std::vector<LinkID> get_sorted_logicals(LinkRelations& link_rel, LinkID topo)
+	{
+		auto result = link_rel.get_parents(topo, NET_RS_LOGICAL);
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	NodeSplit* add_split_node(NodeSystem* sys, const std::string& basename)
+	{
+		auto sp = new NodeSplit();
+		sp->set_name(sys->make_unique_child_name(util::str_con_cat("sp", basename)));
+		sys->add_child(sp);
+		return sp;
+	}
+
+	impl::Link* ensure_head_split(NodeSystem* sys, impl::Link* input)
+	{
+		using impl::Port;
+		auto& link_rel = sys->get_link_relations();
+
+		// Makes sure a merge node's input comes from a split node, so that its source
+		// can also feed other things. If one has to be inserted, returns the new link
+		// from it to the merge node.
+		if (dynamic_cast<NodeSplit*>(input->get_src()))
+			return input;
+
+		auto mg = static_cast<NodeMerge*>(input->get_sink());
+		auto sp = add_split_node(sys, mg->get_name());
+
+		input->disconnect_sink();
+		input->reconnect_sink(sp->get_endpoint(NET_TOPO, Port::Dir::IN));
+
+		auto to_mg = sys->connect(sp, mg, NET_TOPO);
+		for (auto logical : link_rel.get_parents(input->get_id(), NET_RS_LOGICAL))
+			link_rel.add(logical, to_mg->get_id());
+
+		return to_mg;
+	}
+
+	NodeSystem* create_pulled_out_sys(TopoOptState* tstate, unsigned mg_idx, unsigned input_idx)
+	{
+		using impl::Port;
+
+		// Takes one input out of a shared merge node. Each destination of that input's
+		// traffic is either fed from the input's source directly, if nothing else goes there,
+		// or otherwise gets its own merge node with just the inputs it needs. This never adds
+		// contention, and keeps every merge node fed straight from the sources.
+		NodeSystem* sys = (NodeSystem*)tstate->iter_base_sys->clone();
+		auto& link_rel = sys->get_link_relations();
+
+		auto mg = sys->get_child_as<NodeMerge>(tstate->merge_nodes[mg_idx]->get_name());
+		auto mg_out = mg->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
+		auto bus_sp = static_cast<NodeSplit*>(mg_out->get_sink());
+
+		auto& inputs = tstate->merge_inputs[mg_idx];
+		auto& pulled = inputs[input_idx].second.logicals;
+
+		// The links going into mg. These change as split nodes get inserted.
+		std::vector<impl::Link*> in_links;
+		for (auto& input : inputs)
+			in_links.push_back(sys->get_link(input.second.topo));
+
+		auto bus_outs = bus_sp->get_endpoint(NET_TOPO, Port::Dir::OUT)->links(); // copy!
+		for (auto bus_out : bus_outs)
+		{
+			auto out_logicals = get_sorted_logicals(link_rel, bus_out->get_id());
+
+			unsigned n_pulled = 0;
+			for (auto logical : pulled)
+			{
+				if (std::binary_search(out_logicals.begin(), out_logicals.end(), logical))
+					n_pulled++;
+			}
+
+			if (n_pulled == 0)
+				continue;
+
+			for (auto logical : out_logicals)
+				link_rel.remove(logical, mg_out->get_id());
+
+			bus_out->disconnect_src();
+
+			if (n_pulled == out_logicals.size())
+			{
+				// Only the pulled input's traffic goes here
+				auto& in_link = in_links[input_idx];
+				in_link = ensure_head_split(sys, in_link);
+
+				auto head_sp = static_cast<NodeSplit*>(in_link->get_src());
+				bus_out->reconnect_src(head_sp->get_endpoint(NET_TOPO, Port::Dir::OUT));
+
+				for (auto logical : out_logicals)
+					link_rel.remove(logical, in_link->get_id());
+
+				continue;
+			}
+
+			auto dest_mg = new NodeMerge();
+			dest_mg->set_name(sys->make_unique_child_name(mg->get_name()));
+			sys->add_child(dest_mg);
+
+			bus_out->reconnect_src(dest_mg->get_endpoint(NET_TOPO, Port::Dir::OUT));
+
+			for (unsigned i = 0; i < inputs.size(); i++)
+			{
+				std::vector<LinkID> moving;
+				for (auto logical : inputs[i].second.logicals)
+				{
+					if (std::binary_search(out_logicals.begin(), out_logicals.end(), logical))
+						moving.push_back(logical);
+				}
+
+				if (moving.empty())
+					continue;
+
+				auto& in_link = in_links[i];
+				in_link = ensure_head_split(sys, in_link);
+
+				auto to_dest = sys->connect(in_link->get_src(), dest_mg, NET_TOPO);
+				for (auto logical : moving)
+				{
+					link_rel.remove(logical, in_link->get_id());
+					link_rel.add(logical, to_dest->get_id());
+				}
+			}
+		}
+
+		// Inputs of mg that no longer carry anything go away
+		for (auto in_link : in_links)
+		{
+			if (link_rel.get_parents(in_link->get_id(), NET_RS_LOGICAL).empty())
+				sys->disconnect(in_link);
+		}
+
+		fixup_merge_nodes(sys);
+		fixup_split_nodes(sys);
+
+		return sys;
+	}
+
+	bool evaluate_reshare_candidate(TopoOptState* tstate, unsigned mg1_idx,
+		LinkID moved_out, unsigned mg2_idx)
+	{
+		// The traffic on the moved output of mg1's split enters mg2 instead. Check it against
+		// mg2's inputs, grouped by which of mg1's inputs it arrives on.
+		auto& link_rel = tstate->iter_base_sys->get_link_relations();
+		auto moved = get_sorted_logicals(link_rel, moved_out);
+
+		MergeInputsBySrc moved_inputs;
+		for (auto& input : tstate->merge_inputs[mg1_idx])
+		{
+			TopoWithLogicalLinks moved_input;
+			moved_input.topo = input.second.topo;
+
+			for (auto logical : input.second.logicals)
+			{
+				if (std::binary_search(moved.begin(), moved.end(), logical))
+					moved_input.logicals.push_back(logical);
+			}
+
+			if (!moved_input.logicals.empty())
+				moved_inputs.emplace_back(input.first, std::move(moved_input));
+		}
+
+		ContentionMap& cand_contention = tstate->iter_base_contention;
+		auto mark = cand_contention.checkpoint();
+
+		bool result = evaluate_merge_inputs(tstate, moved_inputs,
+			tstate->merge_inputs[mg2_idx], cand_contention);
+
+		cand_contention.rollback(mark);
+
+		return result;
+	}
+
+	NodeSystem* create_reshared_sys(TopoOptState* tstate, unsigned mg1_idx,
+		LinkID moved_out_id, unsigned mg2_idx)
+	{
+		using impl::Port;
+
+		// Moves one output of mg1's split over to mg2 (giving mg2 a split if it doesn't
+		// have one). The logical links going to that output now enter through mg2,
+		// sharing inputs with what's already there where possible.
+		NodeSystem* sys = (NodeSystem*)tstate->iter_base_sys->clone();
+		auto& link_rel = sys->get_link_relations();
+
+		auto mg1 = sys->get_child_as<NodeMerge>(tstate->merge_nodes[mg1_idx]->get_name());
+		auto mg2 = sys->get_child_as<NodeMerge>(tstate->merge_nodes[mg2_idx]->get_name());
+		auto mg1_out = mg1->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
+		auto mg2_out = mg2->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
+		auto mg2_in_ep = mg2->get_endpoint(NET_TOPO, Port::Dir::IN);
+		auto& mg2_inputs = tstate->merge_inputs[mg2_idx];
+
+		auto moved_out = sys->get_link(moved_out_id);
+		auto moved = get_sorted_logicals(link_rel, moved_out_id);
+
+		// Input side
+		for (auto& input_it : tstate->merge_inputs[mg1_idx])
+		{
+			auto& input = input_it.second;
+
+			std::vector<LinkID> moving;
+			for (auto logical : input.logicals)
+			{
+				if (std::binary_search(moved.begin(), moved.end(), logical))
+					moving.push_back(logical);
+			}
+
+			if (moving.empty())
+				continue;
+
+			auto input_link = sys->get_link(input.topo);
+			bool move_whole = moving.size() == input.logicals.size();
+
+			auto existing_mg2_it = find_merge_input(mg2_inputs, input_it.first);
+			if (existing_mg2_it != mg2_inputs.end())
+			{
+				// mg2 already has an input from the same source: use it
+				for (auto logical : moving)
+					link_rel.add(logical, existing_mg2_it->second.topo);
+
+				if (move_whole)
+				{
+					sys->disconnect(input_link);
+				}
+				else
+				{
+					for (auto logical : moving)
+						link_rel.remove(logical, input.topo);
+				}
+			}
+			else if (move_whole)
+			{
+				// Everything on this input is moving: just reconnect it
+				input_link->disconnect_sink();
+				input_link->reconnect_sink(mg2_in_ep);
+			}
+			else
+			{
+				// Part of this input is moving. The source needs to fan out
+				// to both merge nodes, through a split node.
+				auto to_mg1 = ensure_head_split(sys, input_link);
+				auto to_mg2 = sys->connect(to_mg1->get_src(), mg2, NET_TOPO);
+
+				for (auto logical : moving)
+				{
+					link_rel.remove(logical, to_mg1->get_id());
+					link_rel.add(logical, to_mg2->get_id());
+				}
+			}
+		}
+
+		// Output side
+		for (auto logical : moved)
+			link_rel.remove(logical, mg1_out->get_id());
+
+		auto mg2_sp = dynamic_cast<NodeSplit*>(mg2_out->get_sink());
+		if (!mg2_sp)
+		{
+			// mg2 feeds just one thing. Give it a split node.
+			mg2_sp = add_split_node(sys, mg2->get_name());
+
+			mg2_out->disconnect_src();
+			mg2_out->reconnect_src(mg2_sp->get_endpoint(NET_TOPO, Port::Dir::OUT));
+
+			auto mg_sp_link = sys->connect(mg2, mg2_sp, NET_TOPO);
+			for (auto logical : link_rel.get_parents(mg2_out->get_id(), NET_RS_LOGICAL))
+				link_rel.add(logical, mg_sp_link->get_id());
+
+			mg2_out = mg_sp_link;
+		}
+
+		moved_out->disconnect_src();
+		moved_out->reconnect_src(mg2_sp->get_endpoint(NET_TOPO, Port::Dir::OUT));
+
+		for (auto logical : moved)
+			link_rel.add(logical, mg2_out->get_id());
+
+		fixup_merge_nodes(sys);
+		fixup_split_nodes(sys);
+
+		return sys;
+	}
+
+	NodeSystem* next_pair_merge(TopoOptState* ts)
+	{
+		NodeSystem* result = nullptr;
+
+		unsigned n_merges = ts->merge_nodes.size();
+
+		for (bool exit_loop = false; !exit_loop; )
+		{
+			// Handle loop counters
+			ts->cur_merge2++;
+			if (ts->cur_merge2 >= n_merges)
+			{
+				// cur_merge2 reached end of its loop, check/advance cur_merge1
+				// and reset cur_merge2
+				ts->cur_merge1++;
+				ts->cur_merge2 = ts->cur_merge1 + 1;
+				if (ts->cur_merge1 + 1 >= n_merges) // should be >= n_merges-1 thanks unsigned integers
+				{
+					// Done iteration : out of merge node pairs
+					exit_loop = true;
+					continue;
+				}
+			}
+
+			NodeMerge* mg1 = ts->merge_nodes[ts->cur_merge1];
+			NodeMerge* mg2 = ts->merge_nodes[ts->cur_merge2];
+
+			// Evaluate the proposed combination of cur_merge1 and cur_merge2,
+			// using the topo inputs gathered when the base system was set
+			auto& mg1_inputs = ts->merge_inputs[ts->cur_merge1];
+			auto& mg2_inputs = ts->merge_inputs[ts->cur_merge2];
+
+			// Check if combining the two merge nodes will be okay
+			if (!evaluate_merge_candidate(ts, mg1, mg1_inputs, mg2, mg2_inputs))
+			{
+				continue;
+			}
+			else
+			{
+				// It is okay! Make the merge-combination happen, and return a new system
+				result = create_combined_sys(ts, { ts->cur_merge1, ts->cur_merge2 });
+				exit_loop = true;
+			}
+		}
+
+		return result;
+	}
+
+	NodeSystem* next_group_merge(TopoOptState* ts)
+	{
+		// Starting from each merge node in turn, greedily grow a group of merge nodes
+		// that can all be combined together. Groups of two are already covered by pairs.
+		unsigned n_merges = ts->merge_nodes.size();
+		ContentionMap& cand_contention = ts->iter_base_contention;
+
+		while (ts->cur_a < n_merges)
+		{
+			std::vector<unsigned> group = { ts->cur_a++ };
+			auto mark = cand_contention.checkpoint();
+
+			for (unsigned j = group[0] + 1; j < n_merges; j++)
+			{
+				// Each member contributes its contention with the newcomer
+				auto join_mark = cand_contention.checkpoint();
+				bool ok = true;
+
+				for (auto member : group)
+				{
+					if (!evaluate_merge_inputs(ts, ts->merge_inputs[member],
+						ts->merge_inputs[j], cand_contention))
+					{
+						ok = false;
+						break;
+					}
+				}
+
+				if (ok)
+				{
+					cand_contention.commit(join_mark);
+					group.push_back(j);
+				}
+				else
+				{
+					cand_contention.rollback(join_mark);
+				}
+			}
+
+			cand_contention.rollback(mark);
+
+			if (group.size() >= 3)
+				return create_combined_sys(ts, group);
+		}
+
+		return nullptr;
+	}
+
+	NodeSystem* next_pull_out(TopoOptState* ts)
+	{
+		// Try every input of every shared merge node. This never adds contention,
+		// so there is nothing to check.
+		auto& link_rel = ts->iter_base_sys->get_link_relations();
+		unsigned n_merges = ts->merge_nodes.size();
+
+		while (ts->cur_a < n_merges)
+		{
+			auto& inputs = ts->merge_inputs[ts->cur_a];
+			auto bus_sp = get_bus_split(ts->merge_nodes[ts->cur_a]);
+
+			if (!bus_sp || ts->cur_b >= inputs.size())
+			{
+				ts->cur_a++;
+				ts->cur_b = 0;
+				continue;
+			}
+
+			// If the input's traffic reaches every destination, pulling it out
+			// would just undo the whole merge
+			auto& pulled = inputs[ts->cur_b++].second.logicals;
+			bool some_unaffected = false;
+
+			for (auto bus_out : bus_sp->get_endpoint(NET_TOPO, impl::Port::Dir::OUT)->links())
+			{
+				auto out_logicals = link_rel.get_parents(bus_out->get_id(), NET_RS_LOGICAL);
+				bool affected = std::any_of(out_logicals.begin(), out_logicals.end(),
+					[&](LinkID logical) { return util::exists(pulled, logical); });
+
+				if (!affected)
+				{
+					some_unaffected = true;
+					break;
+				}
+			}
+
+			if (some_unaffected)
+				return create_pulled_out_sys(ts, ts->cur_a, ts->cur_b - 1);
+		}
+
+		return nullptr;
+	}
+
+	NodeSystem* next_reshare(TopoOptState* ts)
+	{
+		// For each output of each shared merge node's split, try moving it to every
+		// other merge node
+		unsigned n_merges = ts->merge_nodes.size();
+
+		while (ts->cur_a < n_merges)
+		{
+			auto bus_sp = get_bus_split(ts->merge_nodes[ts->cur_a]);
+			unsigned n_outs = bus_sp ?
+				bus_sp->get_endpoint(NET_TOPO, impl::Port::Dir::OUT)->links().size() : 0;
+
+			if (ts->cur_b >= n_outs)
+			{
+				ts->cur_a++;
+				ts->cur_b = 0;
+				ts->cur_c = 0;
+				continue;
+			}
+
+			if (ts->cur_c >= n_merges)
+			{
+				ts->cur_b++;
+				ts->cur_c = 0;
+				continue;
+			}
+
+			unsigned mg2_idx = ts->cur_c++;
+			if (mg2_idx == ts->cur_a)
+				continue;
+
+			auto moved_out = bus_sp->get_endpoint(NET_TOPO, impl::Port::Dir::OUT)->links()[ts->cur_b];
+
+			if (evaluate_reshare_candidate(ts, ts->cur_a, moved_out->get_id(), mg2_idx))
+				return create_reshared_sys(ts, ts->cur_a, moved_out->get_id(), mg2_idx);
+		}
+
+		return nullptr;
+	}
 }
 
 
@@ -555,13 +1254,40 @@ void topo_opt::iter_newbase(TopoOptState* ts, NodeSystem* base)
 {
 	ts->iter_base_sys = base;
 	
-	// Get merge nodes
+	// Get merge nodes, sorted by name. Every move visits them in this order and the
+	// first of several equally good candidates wins, so the order decides which local
+	// optimum the search ends up in. Names don't depend on the order the nodes
+	// were created in, or on where they live in memory.
 	ts->merge_nodes = base->get_children_by_type<NodeMerge>();
+	std::sort(ts->merge_nodes.begin(), ts->merge_nodes.end(),
+		[](NodeMerge* l, NodeMerge* r) { return l->get_name() < r->get_name(); });
+
+	// Get the topo inputs of all merge nodes and the logical links going over them,
+	// keyed by source. The base system doesn't change while it's being iterated on,
+	// so this is done once here rather than for every merge node pair.
+	std::unordered_map<impl::HierObject*, SrcID> src_ids;
+	auto& link_rel = base->get_link_relations();
+	unsigned n_merges = ts->merge_nodes.size();
+
+	// Every move queries the base system's relations. Candidates share the frozen
+	// copy until they modify their own.
+	link_rel.freeze();
+
+	ts->merge_inputs.resize(n_merges);
+	for (unsigned i = 0; i < n_merges; i++)
+	{
+		populate_merge_inputs(ts->merge_nodes[i], ts->merge_inputs[i], 
+			link_rel, src_ids);
+	}
 
 	// Initialize which merge nodes we're going to try combining first.
 	// This gets incremented/checked before any combining happens.
 	ts->cur_merge1 = 0;
 	ts->cur_merge2 = 0;
+	ts->cur_move = MoveType::PAIR;
+	ts->cur_a = 0;
+	ts->cur_b = 0;
+	ts->cur_c = 0;
 	
 	// Init/reset contention
 	ts->iter_base_contention.init(ts->fstate->get_n_transmissions());
@@ -577,56 +1303,385 @@ void topo_opt::iter_newbase(TopoOptState* ts, NodeSystem* base)
 NodeSystem* topo_opt::iter_next(TopoOptState* ts)
 {
 	NodeSystem* result = nullptr;
+	bool extra_moves = genie::impl::get_flow_options().topo_extra_moves;
 
-	unsigned n_merges = ts->merge_nodes.size();
+	while (!result && ts->cur_move != MoveType::DONE)
+	{
+		switch (ts->cur_move)
+		{
+		case MoveType::PAIR: result = next_pair_merge(ts); break;
+		case MoveType::GROUP: result = next_group_merge(ts); break;
+		case MoveType::PULL_OUT: result = next_pull_out(ts); break;
+		case MoveType::RESHARE: result = next_reshare(ts); break;
+		default: assert(false); break;
+		}
 
-	for (bool exit_loop = false; !exit_loop; )
+		// Out of moves of this type, go to the next type
+		if (!result)
+		{
+			ts->cur_move = extra_moves ? (MoveType)((int)ts->cur_move + 1) : MoveType::DONE;
+			ts->cur_a = 0;
+			ts->cur_b = 0;
+			ts->cur_c = 0;
+		}
+	}
+
+	return result;
+}
+
+void topo_opt::get_iter_progress(TopoOptState* ts, unsigned* pairs_visited,
+	unsigned* pairs_total)
+{
+	// Only pair merges are counted: the other move kinds come after them, and
+	// get_iter_move() tells which kind iteration has reached.
+	// Merge node pairs (cur_merge1, cur_merge2) are visited in lexicographic order,
+	// with cur_merge1 < cur_merge2
+	unsigned n = ts->merge_nodes.size();
+	unsigned total = n < 2 ? 0 : n*(n - 1) / 2;
+	unsigned m1 = ts->cur_merge1;
+	unsigned m2 = ts->cur_merge2;
+
+	if (m2 == 0)
+		*pairs_visited = 0; // haven't started
+	else if (m1 + 1 >= n)
+		*pairs_visited = total; // done
+	else
+		*pairs_visited = m1*n - m1*(m1 + 1) / 2 + (m2 - m1 - 1) + 1;
+
+	*pairs_total = total;
+}
+
+const char* topo_opt::get_iter_move(TopoOptState* ts)
+{
+	switch (ts->cur_move)
 	{
-		// Handle loop counters
-		ts->cur_merge2++;
-		if (ts->cur_merge2 >= n_merges)
+	case MoveType::PAIR: return "pair merge";
+	case MoveType::GROUP: return "group merge";
+	case MoveType::PULL_OUT: return "pull-out";
+	case MoveType::RESHARE: return "reshare";
+	default: return "no";
+	}
+}
+
+NodeSystem* topo_opt::make_clustered(TopoOptState* ts)
+{
+	// Agglomerative clustering of the base system's merge nodes (each one serving a sink),
+	// using only the contention/exclusivity/importance checks, without implementing anything.
+	// At each step, out of all the pairs that can be combined, combine the pair whose
+	// merge nodes share the most sources, since those shared inputs collapse into one.
+	// This stops when no more pairs can be combined.
+	NodeSystem* orig_base = ts->iter_base_sys;
+	NodeSystem* result = nullptr;
+	unsigned n_steps = 0;
+
+	while (true)
+	{
+		unsigned n_merges = ts->merge_nodes.size();
+		int best_shared = -1;
+		unsigned best_m1 = 0;
+		unsigned best_m2 = 0;
+
+		for (unsigned m1 = 0; m1 < n_merges; m1++)
 		{
-			// cur_merge2 reached end of its loop, check/advance cur_merge1
-			// and reset cur_merge2
-			ts->cur_merge1++;
-			ts->cur_merge2 = ts->cur_merge1 + 1;
-			if (ts->cur_merge1 + 1 >= n_merges) // should be >= n_merges-1 thanks unsigned integers
+			auto& inputs1 = ts->merge_inputs[m1];
+
+			for (unsigned m2 = m1 + 1; m2 < n_merges; m2++)
 			{
-				// Done iteration : out of merge node pairs
-				exit_loop = true;
-				continue;
+				auto& inputs2 = ts->merge_inputs[m2];
+
+				// Count shared sources: both input lists are sorted by source ID
+				int shared = 0;
+				for (auto it1 = inputs1.begin(), it2 = inputs2.begin();
+					it1 != inputs1.end() && it2 != inputs2.end(); )
+				{
+					if (it1->first < it2->first) ++it1;
+					else if (it2->first < it1->first) ++it2;
+					else { shared++; ++it1; ++it2; }
+				}
+
+				if (shared <= best_shared)
+					continue;
+
+				if (!evaluate_merge_candidate(ts, ts->merge_nodes[m1], inputs1,
+					ts->merge_nodes[m2], inputs2))
+					continue;
+
+				best_shared = shared;
+				best_m1 = m1;
+				best_m2 = m2;
 			}
 		}
 
-		NodeSystem* sys = ts->iter_base_sys;
-		NodeMerge* mg1 = ts->merge_nodes[ts->cur_merge1];
-		NodeMerge* mg2 = ts->merge_nodes[ts->cur_merge2];
+		if (best_shared < 0)
+			break;
+
+		// Combine them and continue from the combined system
+		auto combined = create_combined_sys(ts, { best_m1, best_m2 });
+
+		if (result)
+			delete result;
+
+		result = combined;
+		iter_newbase(ts, result);
+		n_steps++;
+	}
+
+	// Leave iteration where it was
+	iter_newbase(ts, orig_base);
 
-		// Evaluate the proposed combination of cur_merge1 and cur_merge2
-		// Get the topo inputs of both merge nodes, get the logical links going
-		// over them, and key the topo inputs by the name of their source
-		MergeInputsBySrc mg1_inputs, mg2_inputs;
-		populate_merge_inputs(mg1, mg1_inputs, sys->get_link_relations());
-		populate_merge_inputs(mg2, mg2_inputs, sys->get_link_relations());
+	genie::log::debug("clustered %u merge nodes in %u steps",
+		(unsigned)ts->merge_nodes.size(), n_steps);
 
-		// Check if combining the two merge nodes will be okay
-		if (!evaluate_merge_candidate(ts, mg1, mg1_inputs, mg2, mg2_inputs))
+	return result;
+}
+
+void topo_opt::cleanup(TopoOptState* ts)
+{
+	delete ts;
+}
+
+std::string topo_opt::topology_key(NodeSystem* sys)
+{
+	// Two topologies are the same if they have the same set of TOPO links,
+	// where each TOPO link is described by the logical links routed over it and
+	// what its endpoints attach to. User-facing ports are described by name.
+	// Split/merge nodes are anonymous (their names depend on how they were created),
+	// so they're described by their type and the logical links that go through them,
+	// which tells apart nodes that share an endpoint but not a route.
+	auto& link_rel = sys->get_link_relations();
+	auto topo_links = sys->get_links(NET_TOPO);
+
+	auto append_ids = [](std::string& str, const std::vector<LinkID>& ids)
+	{
+		for (auto id : ids)
 		{
-			continue;
+			str += std::to_string(id.get_index());
+			str += ',';
 		}
+	};
+
+	// Logical links over each TOPO link, and through each split/merge node
+	std::vector<std::vector<LinkID>> link_logicals;
+	std::unordered_map<impl::Node*, std::vector<LinkID>> node_logicals;
+
+	auto anon_node = [](HierObject* obj) -> impl::Node*
+	{
+		auto node = obj->get_parent();
+		if (dynamic_cast<NodeMerge*>(node) || dynamic_cast<NodeSplit*>(node))
+			return static_cast<impl::Node*>(node);
+		return nullptr;
+	};
+
+	for (auto topo : topo_links)
+	{
+		auto logicals = link_rel.get_parents(topo->get_id(), NET_RS_LOGICAL);
+		std::sort(logicals.begin(), logicals.end());
+
+		for (auto obj : { topo->get_src(), topo->get_sink() })
+		{
+			if (auto node = anon_node(obj))
+			{
+				auto& through = node_logicals[node];
+				through.insert(through.end(), logicals.begin(), logicals.end());
+			}
+		}
+
+		link_logicals.push_back(std::move(logicals));
+	}
+
+	std::unordered_map<impl::Node*, std::string> node_descs;
+	for (auto& entry : node_logicals)
+	{
+		auto& through = entry.second;
+		std::sort(through.begin(), through.end());
+		through.erase(std::unique(through.begin(), through.end()), through.end());
+
+		auto& desc = node_descs[entry.first];
+		desc = dynamic_cast<NodeMerge*>(entry.first) ? "M(" : "S(";
+		append_ids(desc, through);
+		desc += ')';
+	}
+
+	auto describe_endpoint = [&](HierObject* obj)
+	{
+		if (auto node = anon_node(obj))
+			return node_descs[node];
 		else
+			return obj->get_hier_path(sys);
+	};
+
+	std::vector<std::string> link_descs;
+
+	for (unsigned i = 0; i < topo_links.size(); i++)
+	{
+		auto topo = topo_links[i];
+		std::string desc = describe_endpoint(topo->get_src());
+		desc += " -> ";
+		desc += describe_endpoint(topo->get_sink());
+		desc += " : ";
+		append_ids(desc, link_logicals[i]);
+
+		link_descs.push_back(std::move(desc));
+	}
+
+	// Make it independent of link order
+	std::sort(link_descs.begin(), link_descs.end());
+
+	std::string result;
+	for (auto& desc : link_descs)
+	{
+		result += desc;
+		result += '\n';
+	}
+
+	return result;
+}
+
+AreaMetrics topo_opt::estimate_area(NodeSystem* sys)
+{
+	// A quick estimate of the area of the merge and split nodes in a topology-only
+	// system, using the same primitive databases as the real area measurement.
+	// Things that aren't known until the system is implemented are guessed:
+	// - carried width is the width of the fields needed by the logical links' sinks,
+	//   ignoring addressing
+	// - no backpressure or EOP
+	// - merge/split nodes are broken into trees the same way the inner flow does it
+	using impl::Port;
+
+	// These mirror treeify_merge_nodes and treeify_split_nodes
+	constexpr unsigned MAX_MERGE_INPUTS = 4;
+	constexpr unsigned MAX_SPLIT_OUTPUTS = 18;
+	
+	auto& opts = genie::impl::get_flow_options();
+	auto& link_rel = sys->get_link_relations();
+
+	AreaMetrics result;
+
+	// Breaks an N-input (or output) node into a tree of nodes of at most max_radix
+	// inputs, and adds up their areas. Each node in the tree reduces the count by radix-1.
+	auto add_tree = [&](unsigned n, unsigned max_radix, 
+		const std::function<AreaMetrics(unsigned)>& estimate_one)
+	{
+		if (n < 2)
+			return;
+
+		unsigned n_full = (n - 1) / (max_radix - 1);
+		unsigned rem = (n - 1) % (max_radix - 1);
+
+		if (n_full > 0)
+			result += estimate_one(max_radix) * n_full;
+		if (rem > 0)
+			result += estimate_one(rem + 1);
+	};
+
+	for (auto mg : sys->get_children_by_type<NodeMerge>())
+	{
+		unsigned n_inputs = mg->get_endpoint(NET_TOPO, Port::Dir::IN)->links().size();
+		auto topo_out = mg->get_endpoint(NET_TOPO, Port::Dir::OUT)->get_link0();
+
+		// Carried width: union of the fields that the sinks of the routed
+		// logical links need
+		FieldSet fields;
+		if (topo_out)
 		{
-			// It is okay! Make the merge-combination happen, and return a new system
-			result = create_combined_sys(ts, mg1_inputs, mg2_inputs);
-			exit_loop = true;
+			for (auto logical : link_rel.get_parents(topo_out->get_id(), NET_RS_LOGICAL))
+			{
+				auto sink = static_cast<PortRS*>(sys->get_link(logical)->get_sink());
+				fields.add(sink->get_proto().terminal_fields_nonconst());
+			}
 		}
+
+		unsigned width = fields.get_width();
+		unsigned max_radix = opts.no_merge_tree ? std::max(n_inputs, 2U) : MAX_MERGE_INPUTS;
+
+		add_tree(n_inputs, max_radix, [=](unsigned ni)
+		{
+			return NodeMerge::estimate_area(ni, width, false, false);
+		});
+	}
+
+	for (auto sp : sys->get_children_by_type<NodeSplit>())
+	{
+		unsigned n_outputs = sp->get_endpoint(NET_TOPO, Port::Dir::OUT)->links().size();
+		unsigned max_radix = opts.split_tree ? MAX_SPLIT_OUTPUTS : std::max(n_outputs, 2U);
+
+		add_tree(n_outputs, max_radix, [&](unsigned no)
+		{
+			return NodeSplit::estimate_area(no, false, opts.split_unicast);
+		});
 	}
 
 	return result;
 }
 
-void topo_opt::cleanup(TopoOptState* ts)
+namespace
 {
-	delete ts;
+	class SteepestStrategy : public SearchStrategy
+	{
+	public:
+		Verdict offer(unsigned cand_area, unsigned base_area, unsigned kept_area) override
+		{
+			return cand_area < kept_area ? Verdict::KEEP : Verdict::REJECT;
+		}
+
+		bool can_move() const override { return false; }
+	};
+
+	class GreedyStrategy : public SearchStrategy
+	{
+	public:
+		Verdict offer(unsigned cand_area, unsigned base_area, unsigned kept_area) override
+		{
+			return cand_area < base_area ? Verdict::MOVE : Verdict::REJECT;
+		}
+
+		bool can_move() const override { return true; }
+	};
+
+	class AnnealStrategy : public SearchStrategy
+	{
+	public:
+		AnnealStrategy(unsigned seed, double init_temp, double cooling)
+			: m_rng(seed), m_temp(init_temp), m_cooling(cooling)
+		{
+		}
+
+		Verdict offer(unsigned cand_area, unsigned base_area, unsigned kept_area) override
+		{
+			// Pick a starting temperature based on the size of the first base if none given
+			if (m_temp <= 0)
+				m_temp = std::max(1.0, base_area * 0.02);
+
+			// Always take improvements. Take worse candidates with a probability that
+			// shrinks with how much worse they are, and as things cool down.
+			double delta = (double)cand_area - (double)base_area;
+			bool accept = delta < 0 || m_uniform(m_rng) < std::exp(-delta / m_temp);
+
+			m_temp *= m_cooling;
+
+			return accept ? Verdict::MOVE : Verdict::REJECT;
+		}
+
+		bool can_move() const override { return true; }
+
+	protected:
+		std::mt19937 m_rng;
+		std::uniform_real_distribution<double> m_uniform;
+		double m_temp;
+		double m_cooling;
+	};
 }
 
+SearchStrategy* topo_opt::create_strategy(const std::string& name, unsigned seed)
+{
+	auto& opts = genie::impl::get_flow_options();
+
+	if (name == "steepest")
+		return new SteepestStrategy();
+	else if (name == "greedy")
+		return new GreedyStrategy();
+	else if (name == "anneal")
+		return new AnnealStrategy(seed, opts.topo_anneal_temp, opts.topo_anneal_cooling);
+	else
+		throw Exception("unknown topology optimization strategy: " + name);
+}
@@ -3,6 +3,7 @@
 #include <unordered_map>
 #include "network.h"
 #include "flow.h"
+#include "prim_db.h"
 
 namespace genie
 {
@@ -15,7 +16,44 @@ namespace topo_opt
 	TopoOptState* init(NodeSystem* sys, flow::FlowStateOuter& fstate);
 	void iter_newbase(TopoOptState*, NodeSystem*);
 	NodeSystem* iter_next(TopoOptState*);
+	void get_iter_progress(TopoOptState*, unsigned* pairs_visited, unsigned* pairs_total);
+	const char* get_iter_move(TopoOptState*);
+	NodeSystem* make_clustered(TopoOptState*);
 	void cleanup(TopoOptState*);
+
+	// A canonical description of a topology-only system's structure. Equal keys
+	// mean the same topology.
+	std::string topology_key(NodeSystem* sys);
+	AreaMetrics estimate_area(NodeSystem* sys);
+
+	// Decides where the search goes next. The candidates derived from the current
+	// base topology are offered one at a time, in the order iter_next() produces them,
+	// along with their implemented area.
+	class SearchStrategy
+	{
+	public:
+		enum class Verdict
+		{
+			REJECT,	// throw the candidate away
+			KEEP,	// hold on to it, and make it the new base once the current base runs out
+			MOVE	// make it the new base right away
+		};
+
+		virtual ~SearchStrategy() = default;
+
+		// kept_area is the area of the currently-kept candidate, or base_area if there isn't one
+		virtual Verdict offer(unsigned cand_area, unsigned base_area, unsigned kept_area) = 0;
+
+		// Whether offer() can return MOVE. Candidates offered after a MOVE are thrown away,
+		// so such strategies are given one candidate at a time.
+		virtual bool can_move() const = 0;
+	};
+
+	// Strategies, by name:
+	// "steepest": move to the best candidate derived from the base (best-improvement)
+	// "greedy": move to the first candidate that improves on the base (first-improvement)
+	// "anneal": simulated annealing, seeded by the given seed
+	SearchStrategy* create_strategy(const std::string& name, unsigned seed);
 }
 }
 }
\ No newline at end of file
@@ -1604,8 +1604,8 @@ void LU1MXR(LUSOLrec *LUSOL, int K1, int K2, int IX[], REAL AMAXR[])
 {
 #define FastMXR
 #ifdef FastMXR
-  static int  I, *J, *IC, K, LC, LC1, LC2, LR, LR1, LR2;
-  static REAL AMAX;
+  int  I, *J, *IC, K, LC, LC1, LC2, LR, LR1, LR2;
+  REAL AMAX;
 #else
   int  I, J, K, LC, LC1, LC2, LR, LR1, LR2;
   REAL AMAX;
@@ -79,6 +79,7 @@ namespace
 		GetOpt::GetOpt_pp args(argc, argv);
 		
 		args >> GetOpt::OptionPresent("dump_reggraph", opts.dump_reggraph);
+		args >> GetOpt::OptionPresent("check_latency", opts.check_latency);
 		args >> GetOpt::OptionPresent("dump_area", opts.dump_area);
 		args >> GetOpt::OptionPresent("force_full_merge", opts.force_full_merge);
         args >> GetOpt::OptionPresent("no_mdelay", opts.no_mdelay);
@@ -86,6 +87,17 @@ namespace
 		args >> GetOpt::OptionPresent("no_merge_tree", opts.no_merge_tree);
 		args >> GetOpt::OptionPresent("split_tree", opts.split_tree);
 		args >> GetOpt::OptionPresent("split_unicast", opts.split_unicast);
+		args >> GetOpt::Option("jobs", opts.jobs);
+		args >> GetOpt::Option("topo_opt_time", opts.topo_opt_time);
+		args >> GetOpt::Option("topo_opt_iters", opts.topo_opt_iters);
+		args >> GetOpt::OptionPresent("topo_est_screen", opts.topo_est_screen);
+		args >> GetOpt::Option("topo_est_margin", opts.topo_est_margin);
+		args >> GetOpt::Option("topo_opt_strategy", opts.topo_opt_strategy);
+		args >> GetOpt::Option("topo_opt_seed", opts.topo_opt_seed);
+		args >> GetOpt::Option("topo_anneal_temp", opts.topo_anneal_temp);
+		args >> GetOpt::Option("topo_anneal_cooling", opts.topo_anneal_cooling);
+		args >> GetOpt::Option("topo_init", opts.topo_init);
+		args >> GetOpt::OptionPresent("topo_extra_moves", opts.topo_extra_moves);
 
 		
 		{
@@ -0,0 +1,220 @@
+// Times the push-relabel min_st_cut, through both its Graph and CSRGraph overloads,
+// against the augmenting-path implementation it replaced, on random graphs.
+// Build and run with 'make bench'.
+
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include "pch.h"
+#include "graph.h"
+
+using namespace genie::impl::graph;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double elapsed_ms(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	// The augmenting-path min_st_cut that push-relabel replaced, kept as it was apart
+	// from also returning the max-flow value in 'flow'. Its returned cut weight can be
+	// too high: saturated edges inside the source side are counted as cut edges.
+	int old_min_st_cut(Graph& G, E2Attr<int> cap, VertexID s, VertexID t, int* flow)
+	{
+		// Residual graph, with a reverse edge for every edge of G
+		Graph R = G;
+		for (EdgeID e : G.edges())
+		{
+			auto vs = G.verts(e);
+			EdgeID newe = R.newe(vs.second, vs.first);
+			cap[newe] = cap[e];
+		}
+
+		*flow = 0;
+
+		// While a path exists from s to t with >0 residual capacity, use up capacity on it
+		V2Attr<bool> visited;
+		while (true)
+		{
+			for (VertexID v : R.verts())
+				visited[v] = false;
+
+			// Depth-first search from s to t for an augmenting path
+			std::vector<VertexID> path;
+			path.push_back(s);
+
+			while (!path.empty())
+			{
+				VertexID cur_v = path.back();
+				visited[cur_v] = true;
+
+				if (cur_v == t)
+					break;
+
+				bool found = false;
+				for (EdgeID e : R.edges(cur_v))
+				{
+					VPair ev = R.verts(e);
+					if (cap[e] > 0 && cur_v == ev.first && !visited[ev.second])
+					{
+						found = true;
+						path.push_back(ev.second);
+						break;
+					}
+				}
+
+				if (!found)
+					path.pop_back();
+			}
+
+			if (path.empty())
+				break;
+
+			// Find the path's minimum residual capacity and push that much along it
+			int mincap = std::numeric_limits<int>::max();
+			for (unsigned i = 1; i < path.size(); i++)
+				mincap = std::min(mincap, cap[R.dir_edge(path[i-1], path[i])]);
+
+			for (unsigned i = 1; i < path.size(); i++)
+			{
+				cap[R.dir_edge(path[i-1], path[i])] -= mincap;
+				cap[R.dir_edge(path[i], path[i-1])] += mincap;
+			}
+
+			*flow += mincap;
+		}
+
+		// Remove saturated edges and their reverse edges from R, restoring original weights
+		for (EdgeID e : G.iter_edges)
+		{
+			EdgeID e2 = R.redge(e);
+			int cap_e = cap[e];
+			int cap_e2 = cap[e2];
+
+			if (cap_e == 0 || cap_e2 == 0)
+			{
+				R.dele(e);
+				R.dele(e2);
+				cap[e] = (cap_e + cap_e2) / 2;
+			}
+		}
+
+		auto reachable = R.connected_verts(s);
+		std::unordered_set<VertexID> reachable_set(reachable.begin(), reachable.end());
+
+		// Cut edges touch the reachable set and are missing a direction in R
+		int result = 0;
+		for (EdgeID e_g : G.edges())
+		{
+			VPair verts = G.verts(e_g);
+			if (!reachable_set.count(verts.first) && !reachable_set.count(verts.second))
+				continue;
+
+			if (R.dir_edge(verts.first, verts.second) == INVALID_E ||
+				R.dir_edge(verts.second, verts.first) == INVALID_E)
+			{
+				result += cap[e_g];
+				G.dele(e_g);
+			}
+		}
+
+		return result;
+	}
+
+	// Random graph with about 4 edges per vertex and weights 1..9, no parallel edges
+	// or self-loops
+	void make_graph(unsigned n_verts, std::mt19937& rng, Graph* g, E2Attr<int>* weights)
+	{
+		for (unsigned i = 0; i < n_verts; i++)
+			g->newv();
+
+		for (unsigned i = 0; i < 4*n_verts; i++)
+		{
+			VertexID v1 = rng() % n_verts;
+			VertexID v2 = rng() % n_verts;
+			if (v1 == v2 || g->hase(v1, v2))
+				continue;
+
+			auto e = g->newe(v1, v2);
+			(*weights)[e] = 1 + rng() % 9;
+		}
+	}
+}
+
+int main()
+{
+	const unsigned N_PAIRS = 5;
+
+	std::cout << std::setw(10) << "vertices" << std::setw(12) << "old (ms)"
+		<< std::setw(14) << "Graph (ms)" << std::setw(12) << "CSR (ms)"
+		<< std::setw(10) << "old/CSR" << std::setw(14) << "old overcut" << std::endl;
+
+	for (unsigned n_verts : { 100, 400, 1600, 6400 })
+	{
+		std::mt19937 rng(n_verts);
+		Graph g;
+		E2Attr<int> weights;
+		make_graph(n_verts, rng, &g, &weights);
+
+		CSRGraph csr(g);
+		auto csr_weights = csr.to_earray(weights);
+
+		double t_old = 0;
+		double t_graph = 0;
+		double t_csr = 0;
+		unsigned n_overcut = 0;
+
+		for (unsigned i = 0; i < N_PAIRS; i++)
+		{
+			VertexID s = rng() % n_verts;
+			VertexID t = rng() % n_verts;
+			if (s == t)
+				t = (s + 1) % n_verts;
+
+			// The Graph versions delete the cut edges, so give them copies
+			Graph g_old = g;
+			Graph g_new = g;
+			int flow_old;
+
+			auto t0 = Clock::now();
+			int w_old = old_min_st_cut(g_old, weights, s, t, &flow_old);
+			auto t1 = Clock::now();
+			int w_graph = min_st_cut(g_new, weights, s, t);
+			auto t2 = Clock::now();
+			EArray<bool> cut_edges;
+			int w_csr = min_st_cut(csr, csr_weights, csr.to_v(s), csr.to_v(t), &cut_edges);
+			auto t3 = Clock::now();
+
+			// The min cut weight equals the max flow, which the old version gets right
+			// even when it reports too heavy a cut
+			if (w_graph != flow_old || w_csr != flow_old)
+			{
+				std::cerr << "cut weights differ: old flow " << flow_old << ", Graph " <<
+					w_graph << ", CSR " << w_csr << std::endl;
+				return 1;
+			}
+
+			if (w_old != flow_old)
+				n_overcut++;
+
+			t_old += elapsed_ms(t0, t1);
+			t_graph += elapsed_ms(t1, t2);
+			t_csr += elapsed_ms(t2, t3);
+		}
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< std::setw(10) << n_verts
+			<< std::setw(12) << t_old / N_PAIRS
+			<< std::setw(14) << t_graph / N_PAIRS
+			<< std::setw(12) << t_csr / N_PAIRS
+			<< std::setw(9) << std::setprecision(1) << t_old / t_csr << 'x'
+			<< std::setw(10) << n_overcut << " of " << N_PAIRS << std::endl;
+	}
+
+	return 0;
+}
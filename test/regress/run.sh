@@ -0,0 +1,115 @@
+#!/bin/bash
+#
+# Runs GENIE on a set of configs and compares the results of each one against
+# baseline.txt: the area estimates (sums of the comb, reg and mem columns, and
+# the number of entries), and a digest of the generated Verilog.
+#
+# Usage: run.sh [--record] [extra genie options...]
+#   --record   rewrite baseline.txt with the results instead of comparing
+#
+# Passing --check_latency makes every latency solution get checked against a
+# plain lp_solve run, and a config fails if they disagree.
+#
+# Run from anywhere. Uses bin/genie, or $GENIE if set.
+
+# Fixed sort order for globs
+export LC_ALL=C
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$HERE/../.." && pwd)
+GENIE=${GENIE:-$ROOT/bin/genie}
+BASELINE=$HERE/baseline.txt
+
+RECORD=0
+if [ "$1" == "--record" ]; then
+	RECORD=1
+	shift
+fi
+EXTRA_OPTS=("$@")
+
+# name | config | --args | other options
+CASES="
+xbar_d1_n2_m2 | xbar.lua | D=1,N=2,M=2,CLK=1 |
+xbar_d2_n8_m5 | xbar.lua | D=2,N=8,M=5,CLK=1 |
+xbar_d1_n6_m7 | xbar.lua | D=1,N=6,M=7,CLK=1 |
+xbar_d1_n10_m10 | xbar.lua | D=1,N=10,M=10,CLK=1 |
+xbar_d3_n4_m4_clk2 | xbar.lua | D=3,N=4,M=4,CLK=2 |
+xbar_d1_n6_m7_clk3 | xbar.lua | D=1,N=6,M=7,CLK=3 |
+xbar_d1_n8_m8_clk4 | xbar.lua | D=1,N=8,M=8,CLK=4 |
+xbar_d2_n6_m6_greedy | xbar.lua | D=2,N=6,M=6,CLK=1 | --topo_opt_strategy greedy
+sync_n4_m4 | sync.lua | N=4,M=4 |
+sync_n6_m3_nologic | sync.lua | N=6,M=3 | --max_logic_depth 100
+sync_n4_m4_p2p | sync.lua | N=4,M=4,P2P=1 |
+sm_test | ../../examples/sm_test/sm_test.lua | |
+"
+
+trim()
+{
+	echo "$1" | sed -e 's/^ *//' -e 's/ *$//'
+}
+
+RESULTS=$(mktemp)
+N_FAILED=0
+
+while IFS='|' read -r name config args opts; do
+	name=$(trim "$name")
+	[ -z "$name" ] && continue
+	config=$HERE/$(trim "$config")
+	args=$(trim "$args")
+	opts=$(trim "$opts")
+
+	workdir=$(mktemp -d)
+	argopt=()
+	[ -n "$args" ] && argopt=(--args "$args")
+
+	(cd "$workdir" && "$GENIE" --dump_area $opts "${EXTRA_OPTS[@]}" "${argopt[@]}" "$config" \
+		> log.txt 2>&1)
+
+	# GENIE reports errors in its log but still exits with 0
+	if grep -q "^Error" "$workdir/log.txt"; then
+		echo "$name: FAILED"
+		grep "^Error" "$workdir/log.txt"
+		N_FAILED=$((N_FAILED + 1))
+		rm -rf "$workdir"
+		continue
+	fi
+
+	area=$(awk -F'\t' 'NR > 1 { c += $2; r += $3; m += $4; n++ }
+		END { print c + 0, r + 0, m + 0, n + 0 }' "$workdir"/*_area_estimates.txt)
+	verilog=$(cd "$workdir" && cat *.sv | md5sum | cut -c1-16)
+	result="$area $verilog"
+	echo "$name $result" >> "$RESULTS"
+	rm -rf "$workdir"
+
+	if [ $RECORD -eq 1 ]; then
+		echo "$name: $result"
+		continue
+	fi
+
+	expected=$(grep "^$name " "$BASELINE" | cut -d' ' -f2-)
+	if [ "$result" == "$expected" ]; then
+		echo "$name: ok"
+	elif [ "$area" == "$(echo "$expected" | cut -d' ' -f1-4)" ]; then
+		echo "$name: FAILED, same areas but different Verilog"
+		N_FAILED=$((N_FAILED + 1))
+	else
+		echo "$name: FAILED, areas $area, expected $(echo "$expected" | cut -d' ' -f1-4)"
+		N_FAILED=$((N_FAILED + 1))
+	fi
+done <<< "$CASES"
+
+if [ $RECORD -eq 1 ]; then
+	if [ $N_FAILED -eq 0 ]; then
+		echo "# name comb reg mem entries verilog_md5" > "$BASELINE"
+		cat "$RESULTS" >> "$BASELINE"
+	else
+		echo "not recording a baseline, $N_FAILED configs failed"
+	fi
+fi
+
+rm -f "$RESULTS"
+
+if [ $N_FAILED -ne 0 ]; then
+	echo "$N_FAILED configs failed"
+	exit 1
+fi
@@ -0,0 +1,72 @@
+-- Latency constraint regression config: N masters and M slaves with synchronization
+-- constraints on round trips and request arrival times.
+-- Parameters come from --args, e.g. --args N=4,M=4,P2P=1
+
+require 'builder'
+local b = genie.Builder.new()
+local N = tonumber(genie.argv.N or 4)
+local M = tonumber(genie.argv.M or 4)
+-- With P2P=1, master i only talks to slave i, so every logical link is one physical link
+local P2P = tonumber(genie.argv.P2P or 0) == 1
+
+b:component('master')
+	b:clock_sink('clk') b:reset_sink('reset')
+	b:rs_src('out', 'clk')
+		b:signal('valid', 'o_valid') b:signal('ready', 'i_ready')
+		b:signal('data', 'o_data', 32) b:signal('address', 'o_addr', 8)
+	b:rs_sink('in', 'clk')
+		b:signal('valid', 'i_valid') b:signal('ready', 'o_ready')
+		b:signal('data', 'i_data', 16)
+b:component('slave')
+	b:clock_sink('clk') b:reset_sink('reset')
+	b:rs_sink('in', 'clk')
+		b:signal('valid', 'i_valid') b:signal('ready', 'o_ready')
+		b:signal('data', 'i_data', 32)
+		b:logic_depth(3)
+	b:rs_src('out', 'clk')
+		b:signal('valid', 'o_valid') b:signal('ready', 'i_ready')
+		b:signal('data', 'o_data', 16)
+		b:logic_depth(2)
+	b:internal_link('in', 'out', 2)
+
+b:system('ssys')
+	b:clock_sink('clk')
+	b:reset_sink('reset')
+	for i = 1, N do
+		b:instance('master', 'm'..i)
+		b:clock_link('clk', 'm'..i..'.clk') b:reset_link('reset', 'm'..i..'.reset')
+	end
+	for j = 1, M do
+		b:instance('slave', 's'..j)
+		b:clock_link('clk', 's'..j..'.clk') b:reset_link('reset', 's'..j..'.reset')
+	end
+	local req = {}
+	local resp = {}
+	for i = 1, N do
+		req[i] = {}
+		resp[i] = {}
+		for j = 1, M do
+			if not P2P or i == j then
+				req[i][j] = b:rs_link('m'..i..'.out', 's'..j..'.in', j - 1)
+				resp[i][j] = b:rs_link('s'..j..'.out', 'm'..i..'.in')
+			end
+		end
+	end
+
+	-- Round trips from master i through slave s(i) all take the same time,
+	-- which is at least 4 cycles
+	local function s(i) return P2P and i or 1 end
+	for i = 1, N do
+		b:sync_constraint({req[i][s(i)], resp[i][s(i)]}, '>=', 4)
+		if i > 1 then
+			b:sync_constraint({req[i][s(i)], resp[i][s(i)]}, '-', {req[1][s(1)], resp[1][s(1)]}, '=', 0)
+		end
+	end
+
+	-- Requests from different masters arrive within a cycle or so of each other
+	local function t(i) return P2P and i or M end
+	for i = 2, N do
+		b:sync_constraint({req[i][t(i)]}, '-', {req[1][t(1)]}, '<=', 1)
+		b:sync_constraint({req[i][t(i)]}, '-', {req[1][t(1)]}, '>', -2)
+	end
+	b:sync_constraint({req[2][P2P and 2 or 1]}, '>=', 3)
@@ -0,0 +1,58 @@
+-- Crossbar regression config: D independent groups of N masters and M slaves,
+-- spread over CLK clock domains, with a few links left out and one exclusive pair.
+-- Parameters come from --args, e.g. --args D=2,N=8,M=5,CLK=1
+
+require 'builder'
+local b = genie.Builder.new()
+local D = tonumber(genie.argv.D or 3)
+local N = tonumber(genie.argv.N or 4)
+local M = tonumber(genie.argv.M or 4)
+local CLK = tonumber(genie.argv.CLK or 1)
+
+b:component('master')
+	b:clock_sink('clk') b:reset_sink('reset')
+	b:rs_src('out', 'clk')
+		b:signal('valid', 'o_valid') b:signal('ready', 'i_ready')
+		b:signal('data', 'o_data', 32) b:signal('address', 'o_addr', 8)
+	b:rs_sink('in', 'clk')
+		b:signal('valid', 'i_valid') b:signal('ready', 'o_ready')
+		b:signal('data', 'i_data', 16)
+b:component('slave')
+	b:clock_sink('clk') b:reset_sink('reset')
+	b:rs_sink('in', 'clk')
+		b:signal('valid', 'i_valid') b:signal('ready', 'o_ready')
+		b:signal('data', 'i_data', 32)
+		b:logic_depth(3)
+	b:rs_src('out', 'clk')
+		b:signal('valid', 'o_valid') b:signal('ready', 'i_ready')
+		b:signal('data', 'o_data', 16)
+		b:logic_depth(2)
+	b:internal_link('in', 'out', 2)
+
+b:system('xsys')
+	for c = 1, CLK do b:clock_sink('clk'..c) end
+	b:reset_sink('reset')
+	for d = 1, D do
+		for i = 1, N do
+			local n = 'm'..d..'_'..i
+			b:instance('master', n)
+			b:clock_link('clk'..(1 + (i % CLK)), n..'.clk') b:reset_link('reset', n..'.reset')
+		end
+		for j = 1, M do
+			local n = 's'..d..'_'..j
+			b:instance('slave', n)
+			b:clock_link('clk'..(1 + (j % CLK)), n..'.clk') b:reset_link('reset', n..'.reset')
+		end
+		local fwd = {}
+		for i = 1, N do
+			for j = 1, M do
+				if (i + j + d) % 5 ~= 0 then
+					local l = b:rs_link('m'..d..'_'..i..'.out', 's'..d..'_'..j..'.in', j - 1)
+					b:rs_link('s'..d..'_'..j..'.out', 'm'..d..'_'..i..'.in')
+					if i == 1 and j == 1 then fwd[1] = l end
+					if i == 2 and j == 1 then fwd[2] = l end
+				end
+			end
+		end
+		if fwd[1] and fwd[2] then b:make_exclusive({fwd[1], fwd[2]}) end
+	end
@@ -0,0 +1,95 @@
+// Fills a network's LinksContainer with over a million links, well past the old 16-bit
+// index limit, and checks lookup, index recycling, pinning and rebasing.
+// Build and run with 'make test'.
+
+#include <iostream>
+#include "pch.h"
+#include "network.h"
+
+using namespace genie::impl;
+
+namespace
+{
+	int s_n_failed = 0;
+
+	void check(bool cond, const char* what)
+	{
+		if (!cond)
+		{
+			std::cerr << "FAILED: " << what << std::endl;
+			s_n_failed++;
+		}
+	}
+}
+
+int main()
+{
+	const uint32_t N_LINKS = 1200000;
+	const NetType TYPE = 3;
+
+	LinksContainer links;
+	links.set_type(TYPE);
+
+	std::vector<Link*> all;
+	for (uint32_t i = 0; i < N_LINKS; i++)
+	{
+		auto link = new Link();
+		links.insert_new(link);
+		all.push_back(link);
+	}
+
+	check(links.get_next_id() == N_LINKS, "next index after filling");
+	check(all.back()->get_id().get_index() == N_LINKS - 1, "index of last link");
+	check(all.back()->get_id().get_type() == TYPE, "type of last link");
+	check(links.get(LinkID(TYPE, 1100000)) == all[1100000], "lookup above 65535");
+	check(LinkID((uint32_t)all[70000]->get_id()) == all[70000]->get_id(),
+		"LinkID round trip through uint32_t");
+
+	// Indices of removed links get reused before new ones are handed out
+	links.remove(all[5]->get_id());
+	links.remove(all[700000]->get_id());
+	auto recycled1 = new Link();
+	auto recycled2 = new Link();
+	auto id1 = links.insert_new(recycled1);
+	auto id2 = links.insert_new(recycled2);
+	check(id1.get_index() == 700000 && id2.get_index() == 5, "removed indices reused");
+	check(links.get_next_id() == N_LINKS, "next index unchanged by reuse");
+	delete all[5];
+	delete all[700000];
+	all[5] = recycled2;
+	all[700000] = recycled1;
+
+	// Nothing below a pinned index is reused
+	links.remove(id1);
+	uint32_t mark = links.pin_ids();
+	auto pinned = new Link();
+	auto id3 = links.insert_new(pinned);
+	check(id3.get_index() == mark, "pinned index not reused");
+	all[700000] = pinned;
+	delete recycled1;
+
+	// ...but anything above it still is
+	links.remove(id3);
+	auto above = new Link();
+	auto id4 = links.insert_new(above);
+	check(id4.get_index() == mark, "index above pin reused");
+	all[700000] = above;
+	delete pinned;
+
+	// Rebasing shifts links at or above the base, and updates their IDs
+	links.rebase(mark, mark + 10);
+	check(links.get(LinkID(TYPE, mark + 10)) == above, "lookup after rebase");
+	check(above->get_id().get_index() == mark + 10, "ID updated by rebase");
+	check(links.get_next_id() == mark + 11, "next index after rebase");
+
+	check(LINK_INVALID.get_type() == NET_INVALID, "invalid link type");
+
+	for (auto link : all)
+		delete link;
+
+	if (s_n_failed)
+		return 1;
+
+	std::cout << "test_links: passed" << std::endl;
+	return 0;
+}